@@ -0,0 +1,167 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+    StrBase hot path benchmark
+
+    usage: insert [n]
+
+    Every scenario runs on a CountingAllocator so an extra
+    malloc on the StrBaseAdd path shows up as allocs/op.
+    Latency is sampled over batches of BATCH operations,
+    the "metric" lines at the end are read by benchgate.
+*/
+
+#define KEY_SIZE 16
+#define BATCH 32
+
+typedef struct Timer {
+    f64 *samples; // ns/op of each batch
+    u32 count;
+    u64 ops;
+    u64 total; // ns
+} Timer;
+
+static u64 nanos() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000UL + t.tv_nsec;
+}
+
+static void lap(Timer *t, u64 start, u32 ops) {
+    u64 elapsed = nanos() - start;
+    t->samples[t->count++] = (f64)elapsed / ops;
+    t->ops += ops;
+    t->total += elapsed;
+}
+
+static int cmpf64(const void *a, const void *b) {
+    f64 x = *(const f64 *)a, y = *(const f64 *)b;
+    return (x > y) - (x < y);
+}
+
+static f64 percentile(Timer *t, f64 p) {
+    if (!t->count)
+        return 0;
+    return t->samples[(u32)(p * (t->count - 1))];
+}
+
+// runs op for i in [0, n) in timed batches
+#define TIMED(timer, n, i, op)                                                                     \
+    for (u32 _b = 0; _b < (n); _b += BATCH) {                                                      \
+        u32 _e = _b + BATCH < (n) ? _b + BATCH : (n);                                              \
+        u64 _t = nanos();                                                                          \
+        for (u32 i = _b; i < _e; i++) { op; }                                                      \
+        lap(timer, _t, _e - _b);                                                                   \
+    }
+
+static char *makekeys(u32 n) {
+    char *keys = malloc((u64)n * KEY_SIZE);
+    for (u32 i = 0; i < n; i++) snprintf(keys + (u64)i * KEY_SIZE, KEY_SIZE, "key_%08u", i);
+    return keys;
+}
+
+static SString key(char *keys, u32 i) {
+    char *k = keys + (u64)i * KEY_SIZE;
+    return (SString){.len = strlen(k), .data = (i8 *)k};
+}
+
+typedef struct Result {
+    const char *name;
+    f64 opsec;
+    f64 p50;
+    f64 p99;
+    f64 allocsop;
+} Result;
+
+static Result results[8];
+static u32 nresults;
+
+static void scenario(const char *name, Timer *t, Allocator mem) {
+    CountingAllocator c = mem.ctx;
+
+    qsort(t->samples, t->count, sizeof(f64), cmpf64);
+    Result r = {
+        .name = name,
+        .opsec = t->total ? t->ops * 1e9 / t->total : 0,
+        .p50 = percentile(t, 0.5),
+        .p99 = percentile(t, 0.99),
+        .allocsop = t->ops ? (f64)(c->allocs + c->reallocs) / t->ops : 0.0,
+    };
+    results[nresults++] = r;
+
+    printf("%-10s %10lu %12.0f %8.1f %8.1f %10lu %10lu %10lu %9.3f %12lu %12lu |", name, t->ops,
+           r.opsec, r.p50, r.p99, c->allocs, c->reallocs, c->frees, r.allocsop, c->peak, c->live);
+    for (u32 i = 0; i < COUNTING_CLASSES; i++) {
+        if (c->classes[i])
+            printf(" %lu:%lu", 1UL << i, c->classes[i]);
+    }
+    printf("\n");
+
+    CountingAllocatorReset(mem);
+    *t = (Timer){.samples = t->samples};
+}
+
+int main(int argc, char *argv[]) {
+    u32 n = argc > 1 ? strtoul(argv[1], NULL, 0) : 1 << 20;
+
+    char *keys = makekeys(n);
+    StrID *ids = malloc(n * sizeof(StrID));
+    Timer t = {.samples = malloc((2 * n / BATCH + 2) * sizeof(f64))};
+
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *base = &(StrBase){mem};
+
+    printf("%-10s %10s %12s %8s %8s %10s %10s %10s %9s %12s %12s | %s\n", "scenario", "ops",
+           "ops/sec", "p50 ns", "p99 ns", "allocs", "reallocs", "frees", "allocs/op", "peak",
+           "live", "size classes");
+
+    TIMED(&t, n, i, ids[i] = StrBaseAdd(base, key(keys, i)));
+    f64 bytes = (f64)((CountingAllocator)mem.ctx)->live / n;
+    scenario("unique", &t, mem);
+
+    TIMED(&t, n, i, StrBaseAdd(base, key(keys, i)));
+    scenario("duplicate", &t, mem);
+
+    TIMED(&t, n, i, StrBaseDel(base, ids[i]));
+    scenario("release", &t, mem);
+
+    TIMED(&t, n, i, StrBaseDel(base, ids[i]));
+    scenario("delete", &t, mem);
+
+    // steady state add/remove pairs on a warm table
+    u32 window = n / 4 ? n / 4 : 1;
+    for (u32 i = 0; i < window; i++) ids[i] = StrBaseAdd(base, key(keys, i));
+    CountingAllocatorReset(mem);
+    TIMED(&t, n - window, i, {
+        ids[i + window] = StrBaseAdd(base, key(keys, i + window));
+        StrBaseDel(base, ids[i]);
+    });
+    scenario("churn", &t, mem);
+
+    StrBaseFree(base);
+
+    printf("\nbytes/string after unique: %.1f\n\n", bytes);
+
+    for (u32 i = 0; i < nresults; i++) {
+        printf("metric insert.%s.ops_per_sec %.1f higher\n", results[i].name, results[i].opsec);
+        printf("metric insert.%s.ns_p50 %.1f lower\n", results[i].name, results[i].p50);
+        printf("metric insert.%s.ns_p99 %.1f lower\n", results[i].name, results[i].p99);
+        printf("metric insert.%s.allocs_per_op %.3f lower\n", results[i].name,
+               results[i].allocsop);
+    }
+    printf("metric insert.bytes_per_string %.1f lower\n", bytes);
+
+    CountingAllocatorFree(mem);
+    free(t.samples);
+    free(ids);
+    free(keys);
+    return 0;
+}
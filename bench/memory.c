@@ -0,0 +1,148 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+    StrBase memory footprint benchmark
+
+    usage: memory [maxn]
+
+    Inserts N unique strings for N = 1e3, 1e4, ... up to maxn
+    (default 1e6, the full sweep goes to 1e8) for several
+    length distributions and breaks the footprint down per
+    string. Every point runs in its own process so the RSS
+    delta is not polluted by earlier runs. N is capped at
+    STRBASE_MAX_SLOTS, 2^28 with the default STRBASE_GEN_BITS.
+*/
+
+typedef enum dist {
+    DIST_SHORT,      // 8 bytes
+    DIST_UNIFORM,    // 4..64 bytes
+    DIST_LONGTAIL,   // mostly short, 1% up to 1KB
+    DIST_STRUCTURED, // prefix_00000001
+    DIST_COUNT,
+} dist;
+
+static const char *distnames[DIST_COUNT] = {"short", "uniform", "longtail", "structured"};
+
+static u64 rng(u64 *state) {
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+// the index is encoded up front so every string is unique
+static u32 makestr(char *buf, dist d, u32 i, u64 *state) {
+    if (d == DIST_STRUCTURED)
+        return snprintf(buf, 32, "prefix_%08u", i);
+
+    u32 len;
+    switch (d) {
+    case DIST_SHORT: len = 8; break;
+    case DIST_UNIFORM: len = 4 + rng(state) % 61; break;
+    default: {
+        u32 r = rng(state) % 100;
+        if (r < 90)
+            len = 4 + rng(state) % 13;
+        else if (r < 99)
+            len = 16 + rng(state) % 113;
+        else
+            len = 128 + rng(state) % 897;
+    } break;
+    }
+
+    u32 size = 0;
+    u32 v = i;
+    do {
+        buf[size++] = "0123456789abcdefghijklmnopqrstuvwxyz"[v % 36];
+        v /= 36;
+    } while (v);
+    buf[size++] = '_';
+
+    while (size < len) buf[size++] = 'a' + rng(state) % 26;
+    return size;
+}
+
+static u64 rss() {
+    u64 pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        fscanf(f, "%lu %lu", &pages, &resident);
+        fclose(f);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void run(dist d, u32 n) {
+    char buf[1024];
+    u64 state = 0x9e3779b97f4a7c15UL ^ n;
+
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *base = &(StrBase){mem};
+
+    u64 before = rss();
+    for (u32 i = 0; i < n; i++) {
+        u32 len = makestr(buf, d, i, &state);
+        StrBaseAdd(base, (SString){.len = len, .data = (i8 *)buf});
+    }
+    u64 after = rss();
+
+    CountingAllocator c = mem.ctx;
+    f64 strstore = (f64)base->maxslots * sizeof(SString) / n;
+    f64 refs = (f64)base->maxslots * sizeof(u32) / n;
+    f64 freeslots = (f64)base->maxslots * sizeof(u32) / n;
+    f64 hash = (f64)base->hashcap * (sizeof(u32) + sizeof(i32)) / n;
+    // gens + cached hashes and sort keys + occupied, borrowed and dirty bitmaps
+    f64 side = ((f64)base->maxslots * (sizeof(u8) + sizeof(u32) + sizeof(u64)) +
+                3 * BitmapWords(base->maxslots) * sizeof(u64)) /
+               n;
+    f64 total = (f64)c->live / n;
+    f64 payload = total - strstore - refs - freeslots - hash - side;
+    f64 resident = (f64)(after - before) / n;
+
+    printf("%-10s %10u %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %7.2f %7.2f\n",
+           distnames[d], n, total, strstore, refs, freeslots, hash, side, payload, resident,
+           (f64)n / base->maxslots, (f64)base->hashsize / base->hashcap);
+    printf("metric memory.%s.%u.bytes_per_string %.1f lower\n", distnames[d], n, total);
+
+    StrBaseFree(base);
+    CountingAllocatorFree(mem);
+}
+
+int main(int argc, char *argv[]) {
+    u64 maxn = argc > 1 ? strtoull(argv[1], NULL, 0) : 1000000;
+    if (maxn > STRBASE_MAX_SLOTS)
+        maxn = STRBASE_MAX_SLOTS;
+
+    printf("bytes per string\n");
+    printf("%-10s %10s %9s %9s %9s %9s %9s %9s %9s %9s %7s %7s\n", "dist", "n", "total",
+           "strstore", "refs", "freeslots", "hash", "side", "payload", "rss", "slots%", "load");
+    fflush(stdout);
+
+    for (u32 d = 0; d < DIST_COUNT; d++) {
+        for (u64 n = 1000; n <= maxn; n *= 10) {
+            pid_t pid = fork();
+            if (!pid) {
+                run(d, n);
+                fflush(stdout);
+                exit(0);
+            }
+
+            int status;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status))
+                return -1;
+        }
+    }
+
+    return 0;
+}
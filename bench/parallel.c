@@ -0,0 +1,82 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+    StrBaseBuildParallel benchmark
+
+    usage: parallel [n] [threads]
+
+    Interns n tokens drawn from n / 8 distinct strings once with
+    a StrBaseAdd loop and once with StrBaseBuildParallel, threads
+    defaults to the cpu count. Both run on GlobalAllocator, the
+    parallel build copies strings on its workers with any allocator.
+*/
+
+#define KEY_SIZE 16
+
+static u64 nanos() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000UL + t.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    u32 n = argc > 1 ? strtoul(argv[1], NULL, 0) : 1 << 22;
+    u32 threads = argc > 2 ? strtoul(argv[2], NULL, 0) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (!threads)
+        threads = 1;
+
+    char *keys = malloc((u64)n * KEY_SIZE);
+    SString *tokens = malloc(n * sizeof(SString));
+    StrID *ids = malloc(n * sizeof(StrID));
+
+    u64 state = 0x9e3779b97f4a7c15UL;
+    u32 unique = n / 8 ? n / 8 : 1;
+    for (u32 i = 0; i < n; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        char *k = keys + (u64)i * KEY_SIZE;
+        u32 len = snprintf(k, KEY_SIZE, "key_%08u", (u32)(state % unique));
+        tokens[i] = (SString){.len = len, .data = (i8 *)k};
+    }
+
+    StrBase *seq = &(StrBase){GlobalAllocator};
+    u64 start = nanos();
+    for (u32 i = 0; i < n; i++) ids[i] = StrBaseAdd(seq, tokens[i]);
+    f64 seqns = nanos() - start;
+
+    StrBase *par = &(StrBase){GlobalAllocator};
+    start = nanos();
+    StrBaseBuildParallel(par, tokens, n, threads, ids);
+    f64 parns = nanos() - start;
+
+    if (par->hashsize != seq->hashsize) {
+        printf("parallel build disagrees: %u != %u strings\n", par->hashsize, seq->hashsize);
+        return -1;
+    }
+
+    printf("%u tokens, %u strings, %u threads\n", n, par->hashsize, threads);
+    printf("%-10s %12.1f ms %14.0f tokens/sec\n", "StrBaseAdd", seqns / 1e6, n * 1e9 / seqns);
+    printf("%-10s %12.1f ms %14.0f tokens/sec %6.2fx\n\n", "parallel", parns / 1e6,
+           n * 1e9 / parns, seqns / parns);
+
+    printf("metric parallel.sequential.tokens_per_sec %.1f higher\n", n * 1e9 / seqns);
+    printf("metric parallel.build.tokens_per_sec %.1f higher\n", n * 1e9 / parns);
+
+    StrBaseFree(seq);
+    StrBaseFree(par);
+    free(ids);
+    free(tokens);
+    free(keys);
+    return 0;
+}
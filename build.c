@@ -6,6 +6,7 @@ int main(int argc, char *argv[]) {
         sb_chdir_exe();
         sb_mkdir("build/");
         sb_mkdir("build/tests");
+        sb_mkdir("build/bench");
         sb_target_dir("build/");
 
         if (sb_check_arg("init")) {
@@ -103,6 +104,7 @@ int main(int argc, char *argv[]) {
                 sb_add_flag("g");
                 sb_add_flag("fsanitize=address");
                 sb_link_library("m");
+                sb_link_library("pthread");
 
                 char buf[PATH_MAX + 1] = {0};
                 char final[PATH_MAX + 1] = {0};
@@ -130,6 +132,97 @@ int main(int argc, char *argv[]) {
 
             sb_export_command();
         }
+
+        // benchmarks
+        sb_FOREACHFILE("bench/", bench) {
+            if (sb_cmpext(bench, ".c"))
+                continue;
+            sb_EXEC() {
+                sb_add_file(bench);
+
+                sb_add_include_path("include/");
+                sb_add_include_path("lib/include");
+
+                sb_add_flag("g");
+                sb_add_flag("O2");
+                sb_link_library("m");
+                sb_link_library("pthread");
+
+                char buf[PATH_MAX + 1] = {0};
+                char final[PATH_MAX + 1] = {0};
+                strncpy(buf, bench, PATH_MAX);
+
+                char *name = sb_stripext(sb_basename(buf));
+                snprintf(final, PATH_MAX, "bench/%s", name);
+
+                sb_set_out(final);
+
+                sb_export_command();
+            }
+        }
+
+        // tools
+        sb_EXEC() {
+            sb_add_file("tools/hashstat.c");
+
+            sb_add_include_path("include/");
+            sb_add_include_path("lib/include");
+
+            sb_add_flag("g");
+            sb_add_flag("O2");
+            sb_link_library("m");
+            sb_link_library("pthread");
+
+            sb_set_out("hashstat");
+
+            sb_export_command();
+        }
+
+        sb_EXEC() {
+            sb_add_file("tools/benchgate.c");
+
+            sb_add_include_path("include/");
+            sb_add_include_path("lib/include");
+
+            sb_add_flag("g");
+            sb_link_library("m");
+
+            sb_set_out("benchgate");
+
+            sb_export_command();
+        }
+
+        sb_EXEC() {
+            sb_add_file("tools/strbased.c");
+
+            sb_add_include_path("include/");
+            sb_add_include_path("lib/include");
+
+            sb_add_flag("g");
+            sb_add_flag("O2");
+            sb_link_library("m");
+            sb_link_library("pthread");
+
+            sb_set_out("strbased");
+
+            sb_export_command();
+        }
+    }
+
+    // benchmark regression gate, threshold comes from
+    // STRBASE_BENCH_THRESHOLD (percent)
+    if (sb_check_arg("bench") || sb_check_arg("rebaseline")) {
+        sb_build_start(argc, argv);
+        sb_target_dir("build/");
+        sb_CMD() {
+            sb_cmd_main("build/benchgate");
+            sb_cmd_arg("bench/baseline.txt");
+            if (sb_check_arg("rebaseline")) {
+                sb_cmd_arg("update");
+            }
+        }
+        sb_build_end();
+        return 0;
     }
 
     if (!sb_check_arg("no-test")) {
@@ -19,10 +19,97 @@
 #define STRBASE_MIN_SIZE 4
 #endif
 
-typedef u32 StrID; // direct index into strstore
+// address space reserved per slot array with STRBASE_VMEM,
+// clamped to what a StrID can address
+#ifndef STRBASE_VMEM_SLOTS
+#define STRBASE_VMEM_SLOTS (1 << 28)
+#endif
+
+// read size of StrBaseInternFile, tokens longer than this
+// grow the buffer
+#ifndef STRBASE_STREAM_CHUNK
+#define STRBASE_STREAM_CHUNK (1 << 20)
+#endif
+
+// tokens interned per StrBaseBatchFunc call
+#ifndef STRBASE_STREAM_BATCH
+#define STRBASE_STREAM_BATCH 1024
+#endif
+
+// write buffer of the WAL and of snapshots, only StrBaseWalSync
+// waits for the disk
+#ifndef STRBASE_WAL_BUFFER
+#define STRBASE_WAL_BUFFER (1 << 16)
+#endif
+
+// slots per block of the prefix index
+#ifndef STRBASE_PREFIX_BLOCK
+#define STRBASE_PREFIX_BLOCK 512
+#endif
+
+// posting lists of the trigram index, trigrams are hashed into
+// them so a list can hold strings without its trigram
+#ifndef STRBASE_TRIGRAM_BUCKETS
+#define STRBASE_TRIGRAM_BUCKETS (1 << 16)
+#endif
+
+typedef enum strbase_flags {
+    // slot arrays are reserved up front and committed as they
+    // grow, so they never move and growth never copies
+    STRBASE_VMEM = 1 << 0,
+    // back the slot arrays with huge pages (needs STRBASE_VMEM)
+    STRBASE_HUGEPAGES = 1 << 1,
+    // hand out the lowest free slot instead of the most recently
+    // freed one, keeps live IDs packed at the bottom of the range
+    STRBASE_DENSE = 1 << 2,
+    // keep the strings in lexicographic order for
+    // StrBasePrefixSearch, costs a sorted insert per new string
+    STRBASE_PREFIX = 1 << 3,
+    // keep posting lists of every trigram for
+    // StrBaseSubstringSearch
+    STRBASE_TRIGRAM = 1 << 4,
+    // set by StrBaseFreeze, new strings are turned away
+    STRBASE_FROZEN = 1 << 5,
+} strbase_flags;
+
+// StrIDs carry a per slot generation in their upper bits so
+// an ID held past its final StrBaseDel is detected in O(1).
+// Generation 0 IDs are plain slot indices. Every bit taken
+// halves the slot range, 4 bits leave 2^28 slots and catch a
+// stale ID until its slot was reused 16 times.
+#ifndef STRBASE_GEN_BITS
+#define STRBASE_GEN_BITS 4
+#endif
+
+#if STRBASE_GEN_BITS > 8
+#error "STRBASE_GEN_BITS must fit in a u8"
+#endif
+
+#define STRBASE_INDEX_BITS (32 - STRBASE_GEN_BITS)
+#define STRBASE_SLOT_MASK ((u32)(((u64)1 << STRBASE_INDEX_BITS) - 1))
+#define STRBASE_GEN_MASK ((u8)((1 << STRBASE_GEN_BITS) - 1))
+
+// the all ones slot is never handed out, it would alias STRBASE_INAVLID_STR
+#define STRBASE_MAX_SLOTS STRBASE_SLOT_MASK
+
+#define STRBASE_VMEM_RESERVE                                                                       \
+    ((u64)STRBASE_VMEM_SLOTS < (u64)STRBASE_MAX_SLOTS + 1 ? (u64)STRBASE_VMEM_SLOTS                \
+                                                          : (u64)STRBASE_MAX_SLOTS + 1)
+
+typedef u32 StrID; // generation | index into strstore
+
+#define StrIDSlot(id) ((u32)(id) & STRBASE_SLOT_MASK)
+#if STRBASE_GEN_BITS
+#define StrIDGen(id) ((u8)((u32)(id) >> STRBASE_INDEX_BITS))
+#define MakeStrID(slot, gen) ((StrID)(((u32)(gen) << STRBASE_INDEX_BITS) | (slot)))
+#else
+#define StrIDGen(id) ((u8)0)
+#define MakeStrID(slot, gen) ((StrID)(slot))
+#endif
 
 typedef struct StrBase {
     Allocator mem; // Assume Dynamic Memory
+    u32 flags;     // strbase_flags, fixed once the base is in use
 
     // hashmap for deduplication
     u32 *stridx;
@@ -34,34 +121,260 @@ typedef struct StrBase {
     // Stable Storage (index stability)
     SString *strstore;
     u32 *refs;
-    u32 *freeslots; // free list
+    u32 *hashes;    // full hash of every live slot
+    u64 *sortkeys;  // first 8 bytes of every live slot, big endian
+    u8 *gens;       // bumped every time a slot is freed
+    u64 *occupied;  // bitmap of live slots
+    u64 *borrowed;  // live slots pointing at caller memory
+    u64 *dirty;     // slots changed since the last save
+    u32 *freeslots; // free list, unused with STRBASE_DENSE
 
     u32 freesize;
     u32 maxslots;
+    u32 lowfree; // STRBASE_DENSE: no free slot below this
+    u32 gencap;  // gens never shrinks, so truncated slots stay bumped
+
+    // strings of the parallel build share one allocation
+    u8 *block;
+    u64 blocksize;
+    u32 blocklive;
+
+    // STRBASE_PREFIX, built by the first search
+    struct StrBasePrefix *prefix;
+    // STRBASE_TRIGRAM, built by the first search
+    struct StrBaseTrigram *trigram;
+
+    // persistence
+    struct StrBaseWal *wal; // NULL unless StrBaseWalOpen
+    u32 epoch;              // of the last snapshot saved or loaded
 } StrBase;
 
-#define GetStr(base, id) ((base)->strstore[id])
+// unchecked, see StrBaseGet
+#define GetStr(base, id) ((base)->strstore[StrIDSlot(id)])
 
 StrID StrBaseAdd(StrBase *base, SString s);
+
+// Like StrBaseAdd but a new entry stores s itself instead of a copy,
+// s has to outlive it. Borrowed bytes are never freed by the base.
+// A string that is already interned keeps its existing storage.
+StrID StrBaseAddBorrowed(StrBase *base, SString s);
+
+// lookup without taking a reference, STRBASE_INAVLID_STR on miss
+StrID StrBaseFind(StrBase *base, SString s);
+
+// 1 if id refers to a live string, 0 for stale or invalid IDs
+bool8 StrBaseValid(StrBase *base, StrID id);
+
+// checked GetStr, returns an empty string for stale IDs
 SString StrBaseGet(StrBase *base, StrID s);
+
+// stale IDs are ignored
 void StrBaseDel(StrBase *base, StrID s);
 
+// Cursor over live strings in slot order, start from {0}.
+// Releasing the current string while iterating is fine.
+typedef struct StrBaseIter {
+    u32 slot;
+} StrBaseIter;
+
+// Returns the next live StrID, STRBASE_INAVLID_STR when done
+StrID StrBaseIterNext(StrBase *base, StrBaseIter *it);
+
+// Presizes the slot arrays and the hash table so that
+// nstrings strings fit without any further growth
+void StrBaseReserve(StrBase *base, u32 nstrings);
+
+// Renumbers live strings into [0, count) keeping their order and
+// truncates the slot arrays to count, which is returned. remap may
+// be NULL, otherwise it needs maxslots entries and receives the new
+// StrID for every old slot (STRBASE_INAVLID_STR for free slots).
+// Every StrID handed out before is stale afterwards, also once the
+// base grows back over the truncated slots.
+u32 StrBaseCompact(StrBase *base, StrID *remap);
+
+// Renumbers live strings into [0, count) in lexicographic order
+// (bytewise, shorter first on ties) like StrBaseCompact and freezes
+// the base, so comparing StrIDSlot of two IDs compares their strings.
+// Generations are kept for stale detection, compare slots rather than
+// whole IDs. Adding a string a frozen base does not hold returns
+// STRBASE_INAVLID_STR, adding one it holds and releasing work as
+// usual. Clearing STRBASE_FROZEN from flags thaws it, strings added
+// after that are not in order.
+u32 StrBaseFreeze(StrBase *base, StrID *remap);
+
+// Adds every live string of src to dst, duplicates add up their
+// refcounts. src is left untouched and the cached hashes are reused
+// so no string is rehashed. remap may be NULL, otherwise it needs
+// src->maxslots entries and receives the dst StrID for every src
+// slot (STRBASE_INAVLID_STR for free slots).
+void StrBaseMerge(StrBase *dst, StrBase *src, StrID *remap);
+
+// Interns n tokens on nthreads threads, equivalent to calling
+// StrBaseAdd on each of them. ids may be NULL, otherwise it receives
+// the StrID of every token. Only a fresh base is built in parallel,
+// anything else falls back to StrBaseAdd. The calling thread makes
+// a single allocation for all new strings and each worker copies its
+// share into it, so any allocator works. That block is freed with the
+// last of its strings.
+void StrBaseBuildParallel(StrBase *base, SString *tokens, u32 n, u32 nthreads, StrID *ids);
+
+// receives the IDs of the next n tokens in file order
+typedef void (*StrBaseBatchFunc)(void *ctx, StrID *ids, u32 n);
+
+// Streams filename through a STRBASE_STREAM_CHUNK buffer, splits it
+// on any byte of delims (empty tokens are skipped) and interns every
+// token. batch may be NULL. Returns the number of tokens, 0 if the
+// file could not be opened.
+u64 StrBaseInternFile(StrBase *base, SString filename, const char *delims,
+                      StrBaseBatchFunc batch, void *ctx);
+
+// Bytes StrBaseExportDict needs for the string data, the offsets
+// need maxslots + 1 entries and the validity bitmap
+// (maxslots + 63) / 64 words.
+u64 StrBaseExportDictSize(StrBase *base);
+
+// Writes every slot in StrID order as an Arrow style dictionary, the
+// string of slot i is bytes[offsets[i], offsets[i + 1]). Free slots
+// are nulls, empty in bytes and clear in validity (LSB first, may be
+// NULL). Returns the number of entries, base->maxslots.
+u32 StrBaseExportDict(StrBase *base, u8 *bytes, u64 *offsets, u64 *validity);
+
+// Interns the n entries of a dictionary in that layout, validity may
+// be NULL if there are no nulls. With borrow set the strings point
+// into bytes, which has to outlive the base. Into an empty base entry
+// i lands in slot i, so an exported dictionary comes back with the
+// same slots. A repeated string adds to the refcount of its first
+// occurrence. ids may be NULL, otherwise it receives the StrID of
+// every entry (STRBASE_INAVLID_STR for nulls).
+void StrBaseImportDict(StrBase *base, u8 *bytes, u64 *offsets, u64 *validity, u32 n,
+                       bool8 borrow, StrID *ids);
+
+// Bytes StrBaseGather needs for the strings of ids
+u64 StrBaseGatherSize(StrBase *base, StrID *ids, u32 n);
+
+// Copies the strings of n IDs back to back into out, the string of
+// ids[i] is out[offsets[i], offsets[i + 1]) so offsets needs n + 1
+// entries. Stale IDs come out empty like with StrBaseGet. Strings
+// are prefetched ahead of the copy.
+void StrBaseGather(StrBase *base, StrID *ids, u32 n, u8 *out, u64 *offsets);
+
+// Orders two valid IDs by their strings like memcmp, bytewise and
+// shorter first on ties. Only strings sharing their first 8 bytes
+// are compared in full.
+i32 StrBaseCompare(StrBase *base, StrID a, StrID b);
+
+// Sorts n valid IDs by their strings. A radix sort over the cached
+// 8 byte prefixes does most of the work, runs of equal prefixes are
+// then sorted by the full strings.
+void StrBaseSortIDs(StrBase *base, StrID *ids, u32 n);
+
+// Writes up to max IDs of strings starting with prefix to out in
+// lexicographic order (bytewise, shorter first on ties) and returns
+// how many were written. Needs STRBASE_PREFIX, the first call builds
+// the index and later adds and releases keep it up to date.
+u32 StrBasePrefixSearch(StrBase *base, SString prefix, StrID *out, u32 max);
+
+// Writes up to max IDs of strings containing sub to out in slot order
+// and returns how many were written. Needs STRBASE_TRIGRAM, the
+// posting lists of the trigrams of sub are intersected and what is
+// left is checked against the strings. Patterns shorter than three
+// bytes scan every live string.
+u32 StrBaseSubstringSearch(StrBase *base, SString sub, StrID *out, u32 max);
+
+// Releases unused capacity, IDs are stable so the slot
+// arrays can only shrink down to the highest live StrID.
+// Generations of released slots are kept, IDs into the released
+// range stay stale when the base grows back over it.
+void StrBaseShrink(StrBase *base);
+
+// Writes every slot with its generation and refcount to filename
+// through a temporary file, the previous image stays intact if this
+// fails. Returns 0 on failure.
+bool8 StrBaseSave(StrBase *base, SString filename);
+
+// Loads an image written by StrBaseSave into an empty base, every
+// StrID comes back unchanged. Returns 0 on failure.
+bool8 StrBaseLoad(StrBase *base, SString filename);
+
+// Writes only the slots added or freed since the last save to
+// filename, cheap next to StrBaseSave when little changed. A delta
+// continues the image or delta saved right before it and empties the
+// log like StrBaseCheckpoint. Returns 0 on failure.
+bool8 StrBaseSaveDelta(StrBase *base, SString filename);
+
+// Applies a delta on top of base, which has to hold the image or
+// delta it continues, so a chain is loaded with StrBaseLoad followed
+// by StrBaseLoadDelta for each delta in order. Returns 0 on failure
+// or for a delta that does not continue base.
+bool8 StrBaseLoadDelta(StrBase *base, SString filename);
+
+// Replays the log in filename on top of base, normally just loaded
+// from the last snapshot, and from then on appends every new string,
+// every refcount change and every final release to it. Records are
+// buffered and only durable after StrBaseWalSync. Returns 0 on
+// failure or if the log belongs to a newer snapshot than the one
+// loaded.
+bool8 StrBaseWalOpen(StrBase *base, SString filename);
+
+// group commit, everything logged so far is on disk afterwards
+void StrBaseWalSync(StrBase *base);
+
+// saves a snapshot and empties the log
+bool8 StrBaseCheckpoint(StrBase *base, SString snapshot);
+
+// syncs and closes the log, StrBaseFree does this too
+void StrBaseWalClose(StrBase *base);
+
 void StrBaseFree(StrBase *base);
 
 #ifdef STRBASE_IMPL
 #include "cutils.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <strbase.h>
 #include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 // hashmap
-static void HashResize(StrBase *base) {
-    if (base->hashsize < base->hashcap * STRBASE_LOAD_MAX)
-        return;
 
-    u32 oldsize = base->hashcap;
-    while (base->hashsize >= base->hashcap * STRBASE_LOAD_MAX) {
-        base->hashcap = base->hashcap ? base->hashcap * 2 : STRBASE_MIN_SIZE;
+// robin hood insert of a slot known not to be in the table
+static void HashPlace(StrBase *base, u32 key) {
+    u32 counter = 0;
+    u32 idx = base->hashes[key] % base->hashcap;
+
+    for (u32 i = 0; i < base->hashcap; i++) {
+        if (base->meta[idx] == STRBASE_INAVLID_STR) {
+            // empty
+            base->meta[idx] = counter;
+            base->stridx[idx] = key;
+            return;
+        }
+
+        if (base->meta[idx] < counter) {
+            // steal
+            u32 tmpcounter = base->meta[idx];
+            u32 tmpslot = base->stridx[idx];
+
+            base->meta[idx] = counter;
+            base->stridx[idx] = key;
+
+            counter = tmpcounter;
+            key = tmpslot;
+        }
+
+        idx = (idx + 1) % base->hashcap;
+        counter++;
     }
+}
+
+static void HashRehash(StrBase *base, u32 newcap) {
+    u32 oldsize = base->hashcap;
+    base->hashcap = newcap;
 
     u32 *oldkeys = base->stridx;
     i32 *oldmeta = base->meta;
@@ -74,74 +387,295 @@ static void HashResize(StrBase *base) {
     for (u32 i = 0; i < oldsize; i++) {
         if (oldmeta[i] == -1)
             continue;
+        HashPlace(base, oldkeys[i]);
+    }
+
+    Free(base->mem, oldkeys, oldsize * sizeof(u32));
+    Free(base->mem, oldmeta, oldsize * sizeof(u32));
+}
 
-        // hash insert
-        u32 key = oldkeys[i];
-        u32 counter = 0;
+// smallest table that holds size entries under the load factor
+static u32 HashCapFor(u32 size) {
+    u32 cap = STRBASE_MIN_SIZE;
+    while (size >= cap * STRBASE_LOAD_MAX) cap *= 2;
+    return cap;
+}
 
-        SString s = base->strstore[key];
-        u32 idx = FNVHash32((u8 *)s.data, s.len) % base->hashcap;
+static void HashResize(StrBase *base) {
+    if (base->hashsize < base->hashcap * STRBASE_LOAD_MAX)
+        return;
 
-        for (u32 i = 0; i < base->hashcap; i++) {
-            if (base->meta[idx] == STRBASE_INAVLID_STR) {
-                // empty
-                base->meta[idx] = counter;
-                base->stridx[idx] = key;
-                break;
-            }
+    u32 newcap = base->hashcap;
+    while (base->hashsize >= newcap * STRBASE_LOAD_MAX) {
+        newcap = newcap ? newcap * 2 : STRBASE_MIN_SIZE;
+    }
 
-            if (base->meta[idx] < counter) {
-                // steal
-                u32 tmpcounter = base->meta[idx];
-                u32 tmpslot = base->stridx[idx];
+    HashRehash(base, newcap);
+}
 
-                base->meta[idx] = counter;
-                base->stridx[idx] = key;
+// dyn array
 
-                counter = tmpcounter;
-                key = tmpslot;
-            }
+static u64 PageRound(u64 size) { return (size + PAGE_SIZE - 1) & ~(u64)(PAGE_SIZE - 1); }
 
-            idx = (idx + 1) % base->hashcap;
-            counter++;
-        }
+// grows or shrinks one slot array, either through the allocator or
+// by committing pages of its virtual reservation in place
+static void *SlotArray(StrBase *base, void *arr, u64 elem, u32 oldmax, u32 newmax) {
+    if (!(base->flags & STRBASE_VMEM))
+        return Realloc(base->mem, arr, oldmax * elem, newmax * elem);
+
+    if (newmax > STRBASE_VMEM_RESERVE) {
+        debugerr("StrBase exceeded STRBASE_VMEM_SLOTS");
+        panic();
     }
 
-    Free(base->mem, oldkeys, oldsize * sizeof(u32));
-    Free(base->mem, oldmeta, oldsize * sizeof(u32));
+    if (!arr) {
+        arr = vmreserve(STRBASE_VMEM_RESERVE * elem);
+        if (base->flags & STRBASE_HUGEPAGES)
+            vmhugepages(arr, STRBASE_VMEM_RESERVE * elem);
+    }
+
+    u64 old = PageRound(oldmax * elem);
+    u64 new = PageRound(newmax * elem);
+    if (new > old && !vmcommit((u8 *)arr + old, new - old)) {
+        debugerr("Failed to commit StrBase slots");
+        panic();
+    }
+    if (new < old)
+        vmdecommit((u8 *)arr + new, old - new);
+
+    return arr;
 }
 
-// dyn array
+#define BitmapWords(slots) (((slots) + 63) / 64)
+#define BitmapGet(map, i) (((map)[(i) / 64] >> ((i) % 64)) & 1)
+#define BitmapSet(map, i) ((map)[(i) / 64] |= 1UL << ((i) % 64))
+#define BitmapClear(map, i) ((map)[(i) / 64] &= ~(1UL << ((i) % 64)))
 
-static u32 AllocSlot(StrBase *base) {
-    if (base->freesize == 0) {
-        u32 oldsize = base->maxslots;
-        base->maxslots = base->maxslots ? base->maxslots * 2 : STRBASE_MIN_SIZE;
+// bitmaps go through SlotArray as bytes so the reservation stays small
+static u64 *SlotBitmap(StrBase *base, u64 *map, u32 oldmax, u32 newmax) {
+    u32 oldwords = BitmapWords(oldmax);
+    u32 newwords = BitmapWords(newmax);
+
+    map = SlotArray(base, map, 1, oldwords * sizeof(u64), newwords * sizeof(u64));
+    if (newwords > oldwords)
+        memset(&map[oldwords], 0, (newwords - oldwords) * sizeof(u64));
+
+    // bits past the end of a shrunk bitmap must stay clear
+    if (newmax < oldmax && newmax % 64)
+        map[newwords - 1] &= (1UL << (newmax % 64)) - 1;
+
+    return map;
+}
+
+static void SlotArrayFree(StrBase *base, void *arr, u64 elem, u32 max) {
+    if (!arr)
+        return;
+    if (base->flags & STRBASE_VMEM) {
+        vmrelease(arr, STRBASE_VMEM_RESERVE * elem);
+        return;
+    }
+    Free(base->mem, arr, max * elem);
+}
+
+// resizes the slot arrays, new slots go on the free list.
+// shrinking is up to the caller, every slot >= newmax must be free
+static void SlotResize(StrBase *base, u32 newmax) {
+    if (newmax > STRBASE_MAX_SLOTS) {
+        debugerr("StrBase exceeded STRBASE_MAX_SLOTS");
+        panic();
+    }
+
+    u32 oldsize = base->maxslots;
+    base->maxslots = newmax;
+    if (base->lowfree > newmax)
+        base->lowfree = newmax;
 
-        base->strstore = Realloc(base->mem, base->strstore, oldsize * sizeof(SString),
-                                 base->maxslots * sizeof(SString));
+    base->strstore = SlotArray(base, base->strstore, sizeof(SString), oldsize, newmax);
+    if (base->maxslots > oldsize)
         memset(&base->strstore[oldsize], 0, (base->maxslots - oldsize) * sizeof(SString));
 
-        base->refs =
-            Realloc(base->mem, base->refs, oldsize * sizeof(u32), base->maxslots * sizeof(u32));
+    base->refs = SlotArray(base, base->refs, sizeof(u32), oldsize, newmax);
+    base->hashes = SlotArray(base, base->hashes, sizeof(u32), oldsize, newmax);
+    base->sortkeys = SlotArray(base, base->sortkeys, sizeof(u64), oldsize, newmax);
+    if (newmax > base->gencap) {
+        base->gens = SlotArray(base, base->gens, sizeof(u8), base->gencap, newmax);
+        memset(&base->gens[base->gencap], 0, newmax - base->gencap);
+        base->gencap = newmax;
+    }
+    base->occupied = SlotBitmap(base, base->occupied, oldsize, newmax);
+    base->borrowed = SlotBitmap(base, base->borrowed, oldsize, newmax);
+    base->dirty = SlotBitmap(base, base->dirty, oldsize, newmax);
+    if (!(base->flags & STRBASE_DENSE))
+        base->freeslots = SlotArray(base, base->freeslots, sizeof(u32), oldsize, newmax);
+
+    for (u32 i = oldsize; i < base->maxslots; i++) {
+        base->refs[i] = 0;
+        if (base->freeslots)
+            base->freeslots[base->freesize] = i;
+        base->freesize++;
+    }
+}
+
+// lowest clear bit at or above lowfree, there has to be one
+static u32 DenseSlot(StrBase *base) {
+    u32 word = base->lowfree / 64;
+    u64 bits = ~base->occupied[word] & (~0UL << (base->lowfree % 64));
+    while (!bits) bits = ~base->occupied[++word];
+
+    u32 slot = word * 64 + __builtin_ctzl(bits);
+    base->lowfree = slot + 1;
+    return slot;
+}
+
+static u32 AllocSlot(StrBase *base) {
+    if (base->freesize == 0) {
+        if (base->maxslots == STRBASE_MAX_SLOTS) {
+            debugerr("StrBase is out of slots, see STRBASE_GEN_BITS");
+            panic();
+        }
 
-        base->freeslots = Realloc(base->mem, base->freeslots, oldsize * sizeof(u32),
-                                  base->maxslots * sizeof(u32));
+        u32 newmax = base->maxslots ? base->maxslots * 2 : STRBASE_MIN_SIZE;
+        if (base->maxslots > STRBASE_MAX_SLOTS / 2)
+            newmax = STRBASE_MAX_SLOTS;
+        SlotResize(base, newmax);
+    }
 
-        for (u32 i = oldsize; i < base->maxslots; i++) { base->freeslots[base->freesize++] = i; }
+    if (base->flags & STRBASE_DENSE) {
+        base->freesize--;
+        return DenseSlot(base);
     }
 
     return base->freeslots[--base->freesize];
 }
 
+static void FreeSlot(StrBase *base, u32 slot) {
+    if (base->flags & STRBASE_DENSE) {
+        base->freesize++;
+        if (slot < base->lowfree)
+            base->lowfree = slot;
+        return;
+    }
+
+    base->freeslots[base->freesize++] = slot;
+}
+
+// free list of every free slot below top, in ascending order
+static void FreeListRebuild(StrBase *base, u32 top) {
+    base->freesize = 0;
+    base->lowfree = top;
+    for (u32 i = 0; i < top; i++) {
+        if (!BitmapGet(base->occupied, i))
+            FreeSlot(base, i);
+    }
+}
+
+// frees the bytes of a live slot, borrowed ones are left alone and
+// block strings only free the block once they are all gone
+static void SlotRelease(StrBase *base, u32 slot) {
+    if (BitmapGet(base->borrowed, slot))
+        return;
+
+    u8 *data = (u8 *)base->strstore[slot].data;
+    if (base->block && data >= base->block && data < base->block + base->blocksize) {
+        if (!--base->blocklive) {
+            Free(base->mem, base->block, base->blocksize);
+            base->block = NULL;
+            base->blocksize = 0;
+        }
+        return;
+    }
+    Free(base->mem, data, base->strstore[slot].len);
+}
+
 // TODO(ELI): Deletion
 
-// Will copy string into internally managed table
-// free string memory afterward
-StrID StrBaseAdd(StrBase *base, SString s) {
+typedef enum strbase_record {
+    STRBASE_REC_ADD = 1,  // slot holds a string
+    STRBASE_REC_FREE = 2, // slot is free
+    STRBASE_REC_REFS = 3, // refcount of a live slot changed
+} strbase_record;
+
+static void WalRecord(StrBase *base, strbase_record type, u32 slot);
+
+// keep the optional indexes in step with the live strings, remove
+// runs while the string is still there. a dropped index is rebuilt
+// when it is needed next
+static void IndexAdd(StrBase *base, u32 slot);
+static void IndexRemove(StrBase *base, u32 slot);
+static void IndexDrop(StrBase *base);
+
+// marks slot for the next delta and logs it
+static void SlotChanged(StrBase *base, strbase_record type, u32 slot) {
+    BitmapSet(base->dirty, slot);
+    if (base->wal)
+        WalRecord(base, type, slot);
+}
+
+// the first 8 bytes of s as a big endian integer, zero padded, so
+// keys order like the strings up to ties
+static u64 SortKey(SString s) {
+    u8 bytes[8] = {0};
+    memcpy(bytes, s.data, s.len < 8 ? s.len : 8);
+
+    u64 key;
+    memcpy(&key, bytes, sizeof(key));
+    return __builtin_bswap64(key);
+}
+
+// claims a slot for s or a copy of it
+static u32 SlotFill(StrBase *base, SString s, u32 hash, u32 refs, bool8 borrow) {
+    u32 slot = AllocSlot(base);
+
+    if (borrow) {
+        base->strstore[slot] = s;
+        BitmapSet(base->borrowed, slot);
+    } else {
+        base->strstore[slot] = Sstrdup(base->mem, s);
+    }
+    base->refs[slot] = refs;
+    base->hashes[slot] = hash;
+    base->sortkeys[slot] = SortKey(s);
+    BitmapSet(base->occupied, slot);
+
+    SlotChanged(base, STRBASE_REC_ADD, slot);
+    IndexAdd(base, slot);
+    return slot;
+}
+
+static StrID HashFind(StrBase *base, SString s, u32 hash) {
+    if (!base->hashsize)
+        return STRBASE_INAVLID_STR;
+
+    u32 idx = hash % base->hashcap;
+
+    for (u32 counter = 0; counter < base->hashcap; counter++) {
+        if (base->meta[idx] == STRBASE_INAVLID_STR || base->meta[idx] < counter)
+            break;
+
+        u32 slot = base->stridx[idx];
+        if (base->hashes[slot] == hash && Sstrcmp(s, base->strstore[slot]))
+            return MakeStrID(slot, base->gens[slot]);
+
+        idx = (idx + 1) % base->hashcap;
+    }
+    return STRBASE_INAVLID_STR;
+}
+
+// find or insert s, refs is added to its refcount
+static StrID HashInsert(StrBase *base, SString s, u32 hash, u32 refs, bool8 borrow) {
+    // a frozen base only takes references to strings it holds
+    if (base->flags & STRBASE_FROZEN) {
+        StrID id = HashFind(base, s, hash);
+        if (id != STRBASE_INAVLID_STR) {
+            base->refs[StrIDSlot(id)] += refs;
+            SlotChanged(base, STRBASE_REC_REFS, StrIDSlot(id));
+        }
+        return id;
+    }
+
     HashResize(base);
 
-    u32 idx = FNVHash32((u8 *)s.data, s.len) % base->hashcap;
+    u32 idx = hash % base->hashcap;
     u32 counter = 0;
 
     u32 out = STRBASE_INAVLID_STR;
@@ -150,15 +684,12 @@ StrID StrBaseAdd(StrBase *base, SString s) {
     for (u32 i = 0; i < base->hashcap; i++) {
         if (base->meta[idx] == STRBASE_INAVLID_STR) {
             // empty
-            u32 slot = AllocSlot(base);
+            u32 slot = SlotFill(base, s, hash, refs, borrow);
 
             base->meta[idx] = counter;
             base->stridx[idx] = slot;
 
-            base->strstore[slot] = Sstrdup(base->mem, s);
-            base->refs[slot] = 1;
-
-            return slot;
+            return MakeStrID(slot, base->gens[slot]);
         }
 
         if (base->meta[idx] < counter) {
@@ -166,11 +697,13 @@ StrID StrBaseAdd(StrBase *base, SString s) {
             break;
         }
 
-        if (Sstrcmp(s, base->strstore[base->stridx[idx]])) {
+        u32 slot = base->stridx[idx];
+        if (base->hashes[slot] == hash && Sstrcmp(s, base->strstore[slot])) {
             // duplicate
             base->hashsize--;
-            base->refs[base->stridx[idx]]++;
-            return base->stridx[idx];
+            base->refs[slot] += refs;
+            SlotChanged(base, STRBASE_REC_REFS, slot);
+            return MakeStrID(slot, base->gens[slot]);
         }
 
         idx = (idx + 1) % base->hashcap;
@@ -182,16 +715,13 @@ StrID StrBaseAdd(StrBase *base, SString s) {
     {
         u32 tmpcounter = base->meta[idx];
 
-        u32 slot = AllocSlot(base);
+        u32 slot = SlotFill(base, s, hash, refs, borrow);
 
         base->meta[idx] = counter;
         base->stridx[idx] = slot;
 
-        base->strstore[slot] = Sstrdup(base->mem, s);
-        base->refs[slot] = 1;
-
         counter = tmpcounter;
-        out = slot;
+        out = MakeStrID(slot, base->gens[slot]);
     }
 
     for (u32 i = 0; i < base->hashcap; i++) {
@@ -222,56 +752,71 @@ StrID StrBaseAdd(StrBase *base, SString s) {
     return STRBASE_INAVLID_STR;
 }
 
-// Returns Zero on miss (this should never happen)
-SString StrBaseGet(StrBase *base, StrID s) { return (SString){0}; }
+// Will copy string into internally managed table
+// free string memory afterward
+StrID StrBaseAdd(StrBase *base, SString s) {
+    return HashInsert(base, s, FNVHash32((u8 *)s.data, s.len), 1, 0);
+}
 
-// Decrement reference counter (free when zero)
-void StrBaseDel(StrBase *base, StrID key) {
-    SString s = GetStr(base, key);
+StrID StrBaseAddBorrowed(StrBase *base, SString s) {
+    return HashInsert(base, s, FNVHash32((u8 *)s.data, s.len), 1, 1);
+}
 
-    u32 idx = FNVHash32((u8 *)s.data, s.len) % base->hashcap;
-    u32 counter = 0;
+StrID StrBaseFind(StrBase *base, SString s) {
+    return HashFind(base, s, FNVHash32((u8 *)s.data, s.len));
+}
 
-    for (u32 i = 0; i < base->hashcap; i++) {
-        if (base->meta[idx] == STRBASE_INAVLID_STR) {
-            // empty
-            return;
-        }
+bool8 StrBaseValid(StrBase *base, StrID id) {
+    u32 slot = StrIDSlot(id);
+    return slot < base->maxslots && base->refs[slot] && base->gens[slot] == StrIDGen(id);
+}
 
-        if (base->meta[idx] < counter) {
-            // steal
-            return;
-        }
+// Returns Zero on miss (stale or invalid id)
+SString StrBaseGet(StrBase *base, StrID s) {
+    if (!StrBaseValid(base, s))
+        return (SString){0};
+    return GetStr(base, s);
+}
 
-        if (Sstrcmp(s, GetStr(base, base->stridx[idx]))) {
-            // match
-            base->refs[base->stridx[idx]]--;
-            if (!base->refs[base->stridx[idx]])
-                break;
-            return;
-        }
+// Decrement reference counter (free when zero)
+void StrBaseDel(StrBase *base, StrID key) {
+    if (!StrBaseValid(base, key))
+        return;
+
+    u32 slot = StrIDSlot(key);
+    if (--base->refs[slot]) {
+        SlotChanged(base, STRBASE_REC_REFS, slot);
+        return;
+    }
 
+    // last reference, find the table entry pointing at slot
+    u32 idx = base->hashes[slot] % base->hashcap;
+    while (base->stridx[idx] != slot || base->meta[idx] == STRBASE_INAVLID_STR) {
         idx = (idx + 1) % base->hashcap;
-        counter++;
     }
+
     // free memory
     {
         base->hashsize--;
 
-        StrID key = base->stridx[idx];
-        base->freeslots[base->freesize++] = key;
+        IndexRemove(base, slot);
+        FreeSlot(base, slot);
 
-        Free(base->mem, base->strstore[key].data, base->strstore[key].len);
-        base->strstore[key] = (SString){};
-        base->refs[key] = 0;
+        SlotRelease(base, slot);
+        base->strstore[slot] = (SString){};
+        BitmapClear(base->borrowed, slot);
+        base->gens[slot] = (base->gens[slot] + 1) & STRBASE_GEN_MASK;
+        BitmapClear(base->occupied, slot);
+
+        SlotChanged(base, STRBASE_REC_FREE, slot);
     }
 
     while (base->meta[idx] != STRBASE_INAVLID_STR) {
         u32 next = (idx + 1) % base->hashcap;
-        if (!base->meta[next])
+        if (base->meta[next] == STRBASE_INAVLID_STR || !base->meta[next])
             break;
 
-        base->meta[idx] = base->meta[next];
+        base->meta[idx] = base->meta[next] - 1;
         base->stridx[idx] = base->stridx[next];
 
         idx = next;
@@ -280,14 +825,1768 @@ void StrBaseDel(StrBase *base, StrID key) {
     base->stridx[idx] = 0;
 }
 
-void StrBaseFree(StrBase *base) {
-    for (u32 i = 0; i < base->maxslots; i++) {
-        Free(base->mem, base->strstore[i].data, base->strstore[i].len);
+StrID StrBaseIterNext(StrBase *base, StrBaseIter *it) {
+    u32 words = BitmapWords(base->maxslots);
+    u32 word = it->slot / 64;
+    if (word >= words)
+        return STRBASE_INAVLID_STR;
+
+    // skip whole free words at a time
+    u64 bits = base->occupied[word] & (~0UL << (it->slot % 64));
+    while (!bits) {
+        if (++word >= words) {
+            it->slot = base->maxslots;
+            return STRBASE_INAVLID_STR;
+        }
+        bits = base->occupied[word];
+    }
+
+    u32 slot = word * 64 + __builtin_ctzl(bits);
+    it->slot = slot + 1;
+    return MakeStrID(slot, base->gens[slot]);
+}
+
+void StrBaseReserve(StrBase *base, u32 nstrings) {
+    if (base->maxslots < nstrings)
+        SlotResize(base, nstrings);
+
+    u32 cap = HashCapFor(nstrings);
+    if (base->hashcap < cap)
+        HashRehash(base, cap);
+}
+
+// moves the strings at order[k] to slot k for k < count, every
+// other slot ends up free. old IDs are invalidated through gens.
+static void SlotRenumber(StrBase *base, u32 *order, u32 count, StrID *remap) {
+    u32 max = base->maxslots;
+    IndexDrop(base);
+
+    StrID *map = remap ? remap : Alloc(base->mem, max * sizeof(StrID));
+    memset(map, -1, max * sizeof(StrID));
+
+    SString *store = Alloc(base->mem, count * sizeof(SString));
+    u32 *refs = Alloc(base->mem, count * sizeof(u32));
+    u32 *hashes = Alloc(base->mem, count * sizeof(u32));
+    u64 *keys = Alloc(base->mem, count * sizeof(u64));
+
+    for (u32 k = 0; k < count; k++) {
+        u32 old = order[k];
+        store[k] = base->strstore[old];
+        refs[k] = base->refs[old];
+        hashes[k] = base->hashes[old];
+        keys[k] = base->sortkeys[old];
+
+        // bump unless the string stays put, so ids of the
+        // previous owner of slot k go stale
+        u8 gen = base->gens[k];
+        if (old != k)
+            gen = (gen + 1) & STRBASE_GEN_MASK;
+        map[old] = MakeStrID(k, gen);
+    }
+
+    for (u32 k = 0; k < count; k++) {
+        base->strstore[k] = store[k];
+        base->refs[k] = refs[k];
+        base->hashes[k] = hashes[k];
+        base->sortkeys[k] = keys[k];
+        base->gens[k] = StrIDGen(map[order[k]]);
+    }
+
+    // vacated slots past count
+    for (u32 i = count; i < max; i++) {
+        if (!BitmapGet(base->occupied, i))
+            continue;
+        base->gens[i] = (base->gens[i] + 1) & STRBASE_GEN_MASK;
+        SlotChanged(base, STRBASE_REC_FREE, i);
+    }
+
+    memset(&base->strstore[count], 0, (max - count) * sizeof(SString));
+    memset(&base->refs[count], 0, (max - count) * sizeof(u32));
+
+    u32 words = BitmapWords(max);
+    u64 *borrowed = Alloc(base->mem, words * sizeof(u64));
+    memcpy(borrowed, base->borrowed, words * sizeof(u64));
+    memset(base->borrowed, 0, words * sizeof(u64));
+    memset(base->occupied, 0, words * sizeof(u64));
+    for (u32 k = 0; k < count; k++) {
+        BitmapSet(base->occupied, k);
+        if (BitmapGet(borrowed, order[k]))
+            BitmapSet(base->borrowed, k);
+    }
+    Free(base->mem, borrowed, words * sizeof(u64));
+
+    // the log sees the renumbered slots as overwritten
+    for (u32 k = 0; k < count; k++) SlotChanged(base, STRBASE_REC_ADD, k);
+
+    for (u32 i = 0; i < base->hashcap; i++) {
+        if (base->meta[i] != STRBASE_INAVLID_STR)
+            base->stridx[i] = StrIDSlot(map[base->stridx[i]]);
+    }
+
+    // everything past count is free
+    base->freesize = 0;
+    base->lowfree = count;
+    for (u32 i = max; i > count; i--) FreeSlot(base, i - 1);
+
+    Free(base->mem, store, count * sizeof(SString));
+    Free(base->mem, refs, count * sizeof(u32));
+    Free(base->mem, hashes, count * sizeof(u32));
+    Free(base->mem, keys, count * sizeof(u64));
+    if (!remap)
+        Free(base->mem, map, max * sizeof(StrID));
+}
+
+u32 StrBaseCompact(StrBase *base, StrID *remap) {
+    u32 max = base->maxslots;
+    u32 count = 0;
+
+    u32 *order = Alloc(base->mem, base->hashsize * sizeof(u32));
+    StrBaseIter it = {0};
+    for (StrID id; (id = StrBaseIterNext(base, &it)) != STRBASE_INAVLID_STR;) {
+        order[count++] = StrIDSlot(id);
+    }
+
+    SlotRenumber(base, order, count, remap);
+    Free(base->mem, order, base->hashsize * sizeof(u32));
+
+    if (count < max) {
+        base->freesize = 0;
+        SlotResize(base, count);
+    }
+    return count;
+}
+
+void StrBaseMerge(StrBase *dst, StrBase *src, StrID *remap) {
+    if (remap)
+        memset(remap, -1, src->maxslots * sizeof(StrID));
+
+    // at most one rehash up front
+    u32 cap = HashCapFor(dst->hashsize + src->hashsize);
+    if (dst->hashcap < cap)
+        HashRehash(dst, cap);
+
+    StrBaseIter it = {0};
+    for (StrID id; (id = StrBaseIterNext(src, &it)) != STRBASE_INAVLID_STR;) {
+        u32 slot = StrIDSlot(id);
+        StrID out = HashInsert(dst, src->strstore[slot], src->hashes[slot], src->refs[slot], 0);
+        if (remap)
+            remap[slot] = out;
+    }
+}
+
+// parallel build
+
+// below this a plain StrBaseAdd loop wins
+#define STRBASE_PARALLEL_MIN 4096
+
+// every bucket range covers at least this many buckets
+#define STRBASE_PARALLEL_RANGE 64
+
+typedef struct BuildShared {
+    StrBase *base;
+    SString *tokens;
+    StrID *ids; // local unique index of every token until the end
+    u32 n;
+    u32 nthreads;
+    u32 nranges;
+    u32 rangeshift;
+    pthread_barrier_t barrier;
+
+    u32 *hashes; // per token
+    u32 *order;  // token indices by partition, later slots by range
+    u32 *counts; // [thread][partition], turned into scatter cursors
+    u32 *starts; // partition p owns order[starts[p], starts[p + 1])
+
+    u32 *tables; // dedupe table of every partition
+    u32 *tablestarts;
+    u32 *uniques; // first token of every unique, laid out like order
+    u32 *urefs;
+    u32 *ucounts;   // uniques per partition
+    u64 *ubytes;    // string bytes per partition, then offsets into the block
+    u32 *slotstarts; // first slot of every partition
+    u32 *spills;     // per range entries that ran past its end
+} BuildShared;
+
+typedef struct BuildThread {
+    BuildShared *b;
+    u32 id;
+    pthread_t thread;
+} BuildThread;
+
+// upper hash bits pick the partition, the lower ones index the tables
+#define BuildPart(hash, parts) ((u32)(((u64)(hash) * (parts)) >> 32))
+
+// column wise prefix sum of counts, rows are threads
+static u32 BuildCursors(BuildShared *b, u32 cols, u32 *starts) {
+    u32 total = 0;
+    for (u32 c = 0; c < cols; c++) {
+        if (starts)
+            starts[c] = total;
+        for (u32 t = 0; t < b->nthreads; t++) {
+            u32 v = b->counts[t * b->nthreads + c];
+            b->counts[t * b->nthreads + c] = total;
+            total += v;
+        }
+    }
+    if (starts)
+        starts[cols] = total;
+    return total;
+}
+
+// single threaded step between dedupe and fill
+static void BuildSlots(BuildShared *b) {
+    StrBase *base = b->base;
+    u32 parts = b->nthreads;
+
+    u32 total = 0;
+    for (u32 p = 0; p < parts; p++) {
+        b->slotstarts[p] = total;
+        total += b->ucounts[p];
+    }
+    b->slotstarts[parts] = total;
+
+    // every slot in [0, total) is taken straight away
+    SlotResize(base, total);
+    base->freesize = 0;
+    base->lowfree = total;
+    HashRehash(base, HashCapFor(total));
+    base->hashsize = total;
+
+    u32 words = BitmapWords(total);
+    memset(base->occupied, -1, words * sizeof(u64));
+    if (total % 64)
+        base->occupied[words - 1] = (1UL << (total % 64)) - 1;
+
+    // one block for every string, each partition copies into its
+    // own range. the extra byte keeps empty strings at the end inside
+    u64 bytes = 0;
+    for (u32 p = 0; p < parts; p++) {
+        u64 size = b->ubytes[p];
+        b->ubytes[p] = bytes;
+        bytes += size;
+    }
+    base->blocksize = bytes + 1;
+    base->block = Alloc(base->mem, base->blocksize);
+    base->blocklive = total;
+
+    // bucket ranges for the table fill, a power of two
+    // that divides hashcap so they line up with the buckets
+    u32 ranges = 1;
+    while (ranges * 2 <= parts && base->hashcap / (ranges * 2) >= STRBASE_PARALLEL_RANGE) {
+        ranges *= 2;
+    }
+    b->nranges = ranges;
+    b->rangeshift = __builtin_ctz(base->hashcap) - __builtin_ctz(ranges);
+
+    memset(b->counts, 0, parts * parts * sizeof(u32));
+}
+
+static void *BuildWorker(void *arg) {
+    BuildThread *t = arg;
+    BuildShared *b = t->b;
+    StrBase *base = b->base;
+    u32 id = t->id;
+    u32 parts = b->nthreads;
+
+    u32 lo = (u64)b->n * id / parts;
+    u32 hi = (u64)b->n * (id + 1) / parts;
+    u32 *counts = &b->counts[id * parts];
+
+    // hash and count a contiguous chunk of tokens
+    for (u32 i = lo; i < hi; i++) {
+        u32 hash = FNVHash32((u8 *)b->tokens[i].data, b->tokens[i].len);
+        b->hashes[i] = hash;
+        counts[BuildPart(hash, parts)]++;
+    }
+    pthread_barrier_wait(&b->barrier);
+
+    if (id == 0) {
+        BuildCursors(b, parts, b->starts);
+
+        // dedupe tables at most half full
+        u32 total = 0;
+        for (u32 p = 0; p < parts; p++) {
+            u32 size = STRBASE_MIN_SIZE;
+            while (size < 2 * (b->starts[p + 1] - b->starts[p])) size *= 2;
+            b->tablestarts[p] = total;
+            total += size;
+        }
+        b->tablestarts[parts] = total;
+        b->tables = Alloc(base->mem, total * sizeof(u32));
+    }
+    pthread_barrier_wait(&b->barrier);
+
+    // scatter by partition
+    for (u32 i = lo; i < hi; i++) {
+        b->order[counts[BuildPart(b->hashes[i], parts)]++] = i;
+    }
+    pthread_barrier_wait(&b->barrier);
+
+    // dedupe partition id, tokens keep their order within it
+    {
+        u32 *table = &b->tables[b->tablestarts[id]];
+        u32 mask = b->tablestarts[id + 1] - b->tablestarts[id] - 1;
+        u32 *uniques = &b->uniques[b->starts[id]];
+        u32 *urefs = &b->urefs[b->starts[id]];
+        memset(table, -1, (mask + 1) * sizeof(u32));
+
+        u32 count = 0;
+        u64 bytes = 0;
+        for (u32 k = b->starts[id]; k < b->starts[id + 1]; k++) {
+            u32 i = b->order[k];
+            u32 hash = b->hashes[i];
+            u32 idx = hash & mask;
+
+            while (1) {
+                u32 u = table[idx];
+                if (u == (u32)-1) {
+                    table[idx] = count;
+                    uniques[count] = i;
+                    urefs[count] = 1;
+                    b->ids[i] = count++;
+                    bytes += b->tokens[i].len;
+                    break;
+                }
+
+                u32 first = uniques[u];
+                if (b->hashes[first] == hash && Sstrcmp(b->tokens[first], b->tokens[i])) {
+                    urefs[u]++;
+                    b->ids[i] = u;
+                    break;
+                }
+                idx = (idx + 1) & mask;
+            }
+        }
+        b->ucounts[id] = count;
+        b->ubytes[id] = bytes;
+    }
+    pthread_barrier_wait(&b->barrier);
+
+    if (id == 0)
+        BuildSlots(b);
+    pthread_barrier_wait(&b->barrier);
+
+    // fill the slots of partition id and count them per bucket range
+    {
+        u32 slot = b->slotstarts[id];
+        u8 *bytes = base->block + b->ubytes[id];
+        for (u32 j = 0; j < b->ucounts[id]; j++, slot++) {
+            u32 first = b->uniques[b->starts[id] + j];
+            SString s = b->tokens[first];
+            if (s.len)
+                memcpy(bytes, s.data, s.len);
+            base->strstore[slot] = (SString){.len = s.len, .data = (i8 *)bytes};
+            bytes += s.len;
+            base->refs[slot] = b->urefs[b->starts[id] + j];
+            base->hashes[slot] = b->hashes[first];
+            base->sortkeys[slot] = SortKey(b->tokens[first]);
+
+            u32 bucket = b->hashes[first] & (base->hashcap - 1);
+            counts[bucket >> b->rangeshift]++;
+        }
+    }
+
+    // final ids of the token chunk, an emptied base may have kept
+    // generations
+    for (u32 i = lo; i < hi; i++) {
+        u32 slot = b->slotstarts[BuildPart(b->hashes[i], parts)] + b->ids[i];
+        b->ids[i] = MakeStrID(slot, base->gens[slot]);
+    }
+    pthread_barrier_wait(&b->barrier);
+
+    if (id == 0)
+        BuildCursors(b, b->nranges, b->starts);
+    pthread_barrier_wait(&b->barrier);
+
+    // scatter slots by bucket range
+    for (u32 slot = b->slotstarts[id]; slot < b->slotstarts[id + 1]; slot++) {
+        u32 bucket = base->hashes[slot] & (base->hashcap - 1);
+        b->order[counts[bucket >> b->rangeshift]++] = slot;
+    }
+    pthread_barrier_wait(&b->barrier);
+
+    // robin hood inside the range, whatever would probe past its
+    // end is kept in the consumed part of order for later
+    if (id < b->nranges) {
+        u32 end = (id + 1) << b->rangeshift;
+        u32 spills = 0;
+
+        for (u32 k = b->starts[id]; k < b->starts[id + 1]; k++) {
+            u32 key = b->order[k];
+            u32 idx = base->hashes[key] & (base->hashcap - 1);
+            u32 counter = 0;
+
+            while (1) {
+                if (idx == end) {
+                    b->order[b->starts[id] + spills++] = key;
+                    break;
+                }
+
+                if (base->meta[idx] == STRBASE_INAVLID_STR) {
+                    base->meta[idx] = counter;
+                    base->stridx[idx] = key;
+                    break;
+                }
+
+                if (base->meta[idx] < counter) {
+                    u32 tmpcounter = base->meta[idx];
+                    u32 tmpslot = base->stridx[idx];
+
+                    base->meta[idx] = counter;
+                    base->stridx[idx] = key;
+
+                    counter = tmpcounter;
+                    key = tmpslot;
+                }
+
+                idx++;
+                counter++;
+            }
+        }
+        b->spills[id] = spills;
+    }
+
+    return NULL;
+}
+
+void StrBaseBuildParallel(StrBase *base, SString *tokens, u32 n, u32 nthreads, StrID *ids) {
+    if (nthreads < 2 || n < STRBASE_PARALLEL_MIN || base->maxslots || base->hashcap ||
+        (base->flags & STRBASE_FROZEN)) {
+        for (u32 i = 0; i < n; i++) {
+            StrID id = StrBaseAdd(base, tokens[i]);
+            if (ids)
+                ids[i] = id;
+        }
+        return;
+    }
+
+    Allocator mem = base->mem;
+    IndexDrop(base);
+    BuildShared b = {
+        .base = base,
+        .tokens = tokens,
+        .ids = ids ? ids : Alloc(mem, n * sizeof(StrID)),
+        .n = n,
+        .nthreads = nthreads,
+
+        .hashes = Alloc(mem, n * sizeof(u32)),
+        .order = Alloc(mem, n * sizeof(u32)),
+        .counts = Alloc(mem, nthreads * nthreads * sizeof(u32)),
+        .starts = Alloc(mem, (nthreads + 1) * sizeof(u32)),
+        .tablestarts = Alloc(mem, (nthreads + 1) * sizeof(u32)),
+        .uniques = Alloc(mem, n * sizeof(u32)),
+        .urefs = Alloc(mem, n * sizeof(u32)),
+        .ucounts = Alloc(mem, nthreads * sizeof(u32)),
+        .ubytes = Alloc(mem, nthreads * sizeof(u64)),
+        .slotstarts = Alloc(mem, (nthreads + 1) * sizeof(u32)),
+        .spills = Alloc(mem, nthreads * sizeof(u32)),
+    };
+    memset(b.counts, 0, nthreads * nthreads * sizeof(u32));
+    pthread_barrier_init(&b.barrier, NULL, nthreads);
+
+    // the calling thread is worker 0
+    BuildThread *threads = Alloc(mem, nthreads * sizeof(BuildThread));
+    for (u32 i = 0; i < nthreads; i++) {
+        threads[i] = (BuildThread){.b = &b, .id = i};
+        if (i && pthread_create(&threads[i].thread, NULL, BuildWorker, &threads[i])) {
+            debugerr("Failed to start StrBase build thread");
+            panic();
+        }
+    }
+    BuildWorker(&threads[0]);
+    for (u32 i = 1; i < nthreads; i++) pthread_join(threads[i].thread, NULL);
+
+    // spills go in last, through the wrapping insert
+    for (u32 r = 0; r < b.nranges; r++) {
+        for (u32 k = 0; k < b.spills[r]; k++) HashPlace(base, b.order[b.starts[r] + k]);
+    }
+
+    for (u32 slot = 0; slot < base->hashsize; slot++) SlotChanged(base, STRBASE_REC_ADD, slot);
+
+    pthread_barrier_destroy(&b.barrier);
+    u32 tables = b.tablestarts[nthreads];
+    Free(mem, threads, nthreads * sizeof(BuildThread));
+    if (!ids)
+        Free(mem, b.ids, n * sizeof(StrID));
+    Free(mem, b.hashes, n * sizeof(u32));
+    Free(mem, b.order, n * sizeof(u32));
+    Free(mem, b.counts, nthreads * nthreads * sizeof(u32));
+    Free(mem, b.starts, (nthreads + 1) * sizeof(u32));
+    Free(mem, b.tables, tables * sizeof(u32));
+    Free(mem, b.tablestarts, (nthreads + 1) * sizeof(u32));
+    Free(mem, b.uniques, n * sizeof(u32));
+    Free(mem, b.urefs, n * sizeof(u32));
+    Free(mem, b.ucounts, nthreads * sizeof(u32));
+    Free(mem, b.ubytes, nthreads * sizeof(u64));
+    Free(mem, b.slotstarts, (nthreads + 1) * sizeof(u32));
+    Free(mem, b.spills, nthreads * sizeof(u32));
+}
+
+// file streaming
+
+// delimiters up to this many are matched 16 bytes at a time
+#define STRBASE_STREAM_SIMD 8
+
+typedef struct StreamState {
+    StrBase *base;
+    StrBaseBatchFunc batch;
+    void *ctx;
+
+    u8 delim[256]; // lookup table
+    u8 simd[STRBASE_STREAM_SIMD];
+    u32 nsimd; // 0 falls back to the table
+
+    SString toks[STRBASE_STREAM_BATCH];
+    u32 hashes[STRBASE_STREAM_BATCH];
+    StrID ids[STRBASE_STREAM_BATCH];
+    u32 pending;
+    u64 total;
+} StreamState;
+
+// offset of the first delimiter in p, len if there is none
+static u32 StreamScan(StreamState *st, u8 *p, u32 len) {
+    u32 i = 0;
+#ifdef __SSE2__
+    if (st->nsimd) {
+        __m128i d[STRBASE_STREAM_SIMD];
+        for (u32 k = 0; k < st->nsimd; k++) d[k] = _mm_set1_epi8(st->simd[k]);
+
+        for (; i + 16 <= len; i += 16) {
+            __m128i v = _mm_loadu_si128((__m128i *)(p + i));
+            __m128i hit = _mm_cmpeq_epi8(v, d[0]);
+            for (u32 k = 1; k < st->nsimd; k++) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, d[k]));
+
+            u32 mask = _mm_movemask_epi8(hit);
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        if (st->delim[p[i]])
+            return i;
+    }
+    return len;
+}
+
+// interns the pending tokens, they point into the read buffer so
+// this runs before the buffer is reused
+static void StreamFlush(StreamState *st) {
+    StrBase *base = st->base;
+
+    // hash the batch up front so the bucket loads overlap
+    for (u32 i = 0; i < st->pending; i++) {
+        st->hashes[i] = FNVHash32((u8 *)st->toks[i].data, st->toks[i].len);
+        if (base->hashcap)
+            __builtin_prefetch(&base->meta[st->hashes[i] % base->hashcap]);
+    }
+
+    for (u32 i = 0; i < st->pending; i++) {
+        st->ids[i] = HashInsert(base, st->toks[i], st->hashes[i], 1, 0);
+    }
+
+    if (st->batch && st->pending)
+        st->batch(st->ctx, st->ids, st->pending);
+
+    st->total += st->pending;
+    st->pending = 0;
+}
+
+static void StreamToken(StreamState *st, u8 *p, u32 len) {
+    if (!len)
+        return;
+
+    st->toks[st->pending++] = (SString){.len = len, .data = (i8 *)p};
+    if (st->pending == STRBASE_STREAM_BATCH)
+        StreamFlush(st);
+}
+
+u64 StrBaseInternFile(StrBase *base, SString filename, const char *delims,
+                      StrBaseBatchFunc batch, void *ctx) {
+    file f = fileopen(filename, FILE_READ);
+    if (f.handle == (u64)-1)
+        return 0;
+
+    StreamState *st = Alloc(base->mem, sizeof(StreamState));
+    *st = (StreamState){.base = base, .batch = batch, .ctx = ctx};
+
+    u32 ndelims = strlen(delims);
+    for (u32 i = 0; i < ndelims; i++) st->delim[(u8)delims[i]] = 1;
+    if (ndelims <= STRBASE_STREAM_SIMD) {
+        memcpy(st->simd, delims, ndelims);
+        st->nsimd = ndelims;
+    }
+
+    u32 cap = STRBASE_STREAM_CHUNK;
+    u8 *buf = Alloc(base->mem, cap);
+    u32 carry = 0; // partial token at the start of buf
+
+    while (1) {
+        if (carry == cap) {
+            // a single token filled the whole buffer
+            buf = Realloc(base->mem, buf, cap, cap * 2);
+            cap *= 2;
+        }
+
+        u64 got = fileread((SString){.len = cap - carry, .data = (i8 *)buf + carry}, f);
+        u32 size = carry + got;
+
+        u32 start = 0;
+        while (1) {
+            u32 end = start + StreamScan(st, buf + start, size - start);
+            if (end == size)
+                break;
+            StreamToken(st, buf + start, end - start);
+            start = end + 1;
+        }
+
+        if (!got) {
+            // EOF, whatever is left is the last token
+            StreamToken(st, buf + start, size - start);
+            StreamFlush(st);
+            break;
+        }
+
+        StreamFlush(st);
+        carry = size - start;
+        memmove(buf, buf + start, carry);
+    }
+
+    u64 total = st->total;
+    Free(base->mem, buf, cap);
+    Free(base->mem, st, sizeof(StreamState));
+    fileclose(f);
+    return total;
+}
+
+// dictionaries
+
+// strings touched ahead of the one being copied
+#define STRBASE_PREFETCH_AHEAD 8
+
+u64 StrBaseExportDictSize(StrBase *base) {
+    u64 size = 0;
+    for (u32 i = 0; i < base->maxslots; i++) size += base->strstore[i].len;
+    return size;
+}
+
+u32 StrBaseExportDict(StrBase *base, u8 *bytes, u64 *offsets, u64 *validity) {
+    // free slots hold {0}, so they come out as empty entries
+    u64 off = 0;
+    for (u32 i = 0; i < base->maxslots; i++) {
+        if (i + STRBASE_PREFETCH_AHEAD < base->maxslots)
+            __builtin_prefetch(base->strstore[i + STRBASE_PREFETCH_AHEAD].data);
+
+        SString s = base->strstore[i];
+        offsets[i] = off;
+        if (s.len)
+            memcpy(bytes + off, s.data, s.len);
+        off += s.len;
+    }
+    offsets[base->maxslots] = off;
+
+    if (validity)
+        memcpy(validity, base->occupied, BitmapWords(base->maxslots) * sizeof(u64));
+    return base->maxslots;
+}
+
+// ids are untrusted, out of range ones are not prefetched
+static void GatherPrefetch(StrBase *base, StrID id) {
+    u32 slot = StrIDSlot(id);
+    if (slot < base->maxslots)
+        __builtin_prefetch(&base->strstore[slot]);
+}
+
+u64 StrBaseGatherSize(StrBase *base, StrID *ids, u32 n) {
+    u64 size = 0;
+    for (u32 i = 0; i < n; i++) {
+        if (i + STRBASE_PREFETCH_AHEAD < n)
+            GatherPrefetch(base, ids[i + STRBASE_PREFETCH_AHEAD]);
+        size += StrBaseGet(base, ids[i]).len;
+    }
+    return size;
+}
+
+void StrBaseGather(StrBase *base, StrID *ids, u32 n, u8 *out, u64 *offsets) {
+    // slot entries twice as far ahead as the bytes they point at,
+    // so the second prefetch finds its pointer in cache
+    u32 far = 2 * STRBASE_PREFETCH_AHEAD;
+    for (u32 i = 0; i < n && i < far; i++) GatherPrefetch(base, ids[i]);
+
+    u64 off = 0;
+    for (u32 i = 0; i < n; i++) {
+        if (i + far < n)
+            GatherPrefetch(base, ids[i + far]);
+        if (i + STRBASE_PREFETCH_AHEAD < n) {
+            u32 slot = StrIDSlot(ids[i + STRBASE_PREFETCH_AHEAD]);
+            if (slot < base->maxslots)
+                __builtin_prefetch(base->strstore[slot].data);
+        }
+
+        // stale ids come out empty
+        SString s = StrBaseGet(base, ids[i]);
+        offsets[i] = off;
+        if (s.len)
+            memcpy(out + off, s.data, s.len);
+        off += s.len;
+    }
+    offsets[n] = off;
+}
+
+void StrBaseImportDict(StrBase *base, u8 *bytes, u64 *offsets, u64 *validity, u32 n,
+                       bool8 borrow, StrID *ids) {
+    bool8 fresh = !base->maxslots && !base->hashcap && n && !(base->flags & STRBASE_FROZEN);
+    if (fresh) {
+        u32 valid = n;
+        if (validity) {
+            valid = 0;
+            for (u32 w = 0; w < BitmapWords(n); w++) valid += __builtin_popcountl(validity[w]);
+            if (n % 64)
+                valid -= __builtin_popcountl(validity[n / 64] & (~0UL << (n % 64)));
+        }
+
+        SlotResize(base, n);
+        HashRehash(base, HashCapFor(valid));
+    }
+
+    for (u32 i = 0; i < n; i++) {
+        StrID id = STRBASE_INAVLID_STR;
+        if (validity && !BitmapGet(validity, i)) {
+            if (ids)
+                ids[i] = id;
+            continue;
+        }
+
+        SString s = {.len = offsets[i + 1] - offsets[i], .data = (i8 *)bytes + offsets[i]};
+        u32 hash = FNVHash32((u8 *)s.data, s.len);
+
+        if (!fresh) {
+            id = HashInsert(base, s, hash, 1, borrow);
+        } else if ((id = HashFind(base, s, hash)) != STRBASE_INAVLID_STR) {
+            base->refs[StrIDSlot(id)]++;
+            SlotChanged(base, STRBASE_REC_REFS, StrIDSlot(id));
+        } else {
+            // entry i goes straight into slot i
+            base->strstore[i] = borrow ? s : Sstrdup(base->mem, s);
+            if (borrow)
+                BitmapSet(base->borrowed, i);
+            base->refs[i] = 1;
+            base->hashes[i] = hash;
+            base->sortkeys[i] = SortKey(s);
+            BitmapSet(base->occupied, i);
+            SlotChanged(base, STRBASE_REC_ADD, i);
+            IndexAdd(base, i);
+
+            HashPlace(base, i);
+            base->hashsize++;
+            id = MakeStrID(i, base->gens[i]);
+        }
+
+        if (ids)
+            ids[i] = id;
+    }
+
+    if (fresh)
+        FreeListRebuild(base, n);
+}
+
+// prefix index
+
+// blocks of slots in string order, every block is sorted and ends
+// below the first string of the next one
+typedef struct StrBasePrefix {
+    u32 **blocks;
+    u32 *sizes;
+    u32 nblocks;
+    u32 cap;
+} StrBasePrefix;
+
+// bytewise, a prefix sorts before the longer string
+static i32 SstrOrder(SString a, SString b) {
+    i32 c = memcmp(a.data, b.data, a.len < b.len ? a.len : b.len);
+    if (c)
+        return c;
+    return (a.len > b.len) - (a.len < b.len);
+}
+
+// first block whose last string is not below s, the last block if
+// every string is
+static u32 PrefixBlock(StrBase *base, StrBasePrefix *p, SString s) {
+    u32 lo = 0, hi = p->nblocks - 1;
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        u32 last = p->blocks[mid][p->sizes[mid] - 1];
+        if (SstrOrder(base->strstore[last], s) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// first position in block b not below s
+static u32 PrefixPos(StrBase *base, StrBasePrefix *p, u32 b, SString s) {
+    u32 lo = 0, hi = p->sizes[b];
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        if (SstrOrder(base->strstore[p->blocks[b][mid]], s) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// opens an empty block at index b
+static void PrefixInsertBlock(StrBase *base, StrBasePrefix *p, u32 b) {
+    if (p->nblocks == p->cap) {
+        u32 cap = p->cap ? p->cap * 2 : 16;
+        p->blocks = Realloc(base->mem, p->blocks, p->cap * sizeof(u32 *), cap * sizeof(u32 *));
+        p->sizes = Realloc(base->mem, p->sizes, p->cap * sizeof(u32), cap * sizeof(u32));
+        p->cap = cap;
+    }
+
+    memmove(&p->blocks[b + 1], &p->blocks[b], (p->nblocks - b) * sizeof(u32 *));
+    memmove(&p->sizes[b + 1], &p->sizes[b], (p->nblocks - b) * sizeof(u32));
+    p->blocks[b] = Alloc(base->mem, STRBASE_PREFIX_BLOCK * sizeof(u32));
+    p->sizes[b] = 0;
+    p->nblocks++;
+}
+
+typedef struct PrefixEntry {
+    SString s;
+    u32 slot;
+} PrefixEntry;
+
+static int PrefixEntryOrder(const void *a, const void *b) {
+    return SstrOrder(((PrefixEntry *)a)->s, ((PrefixEntry *)b)->s);
+}
+
+static void PrefixBuild(StrBase *base) {
+    StrBasePrefix *p = Alloc(base->mem, sizeof(StrBasePrefix));
+    *p = (StrBasePrefix){0};
+    base->prefix = p;
+    if (!base->hashsize)
+        return;
+
+    PrefixEntry *entries = Alloc(base->mem, base->hashsize * sizeof(PrefixEntry));
+    u32 count = 0;
+    StrBaseIter it = {0};
+    for (StrID id; (id = StrBaseIterNext(base, &it)) != STRBASE_INAVLID_STR;) {
+        entries[count++] = (PrefixEntry){GetStr(base, id), StrIDSlot(id)};
+    }
+    qsort(entries, count, sizeof(PrefixEntry), PrefixEntryOrder);
+
+    // blocks start three quarters full so inserts rarely split
+    u32 fill = STRBASE_PREFIX_BLOCK * 3 / 4;
+    for (u32 i = 0; i < count; i++) {
+        if (i % fill == 0)
+            PrefixInsertBlock(base, p, p->nblocks);
+        p->blocks[p->nblocks - 1][p->sizes[p->nblocks - 1]++] = entries[i].slot;
+    }
+
+    Free(base->mem, entries, base->hashsize * sizeof(PrefixEntry));
+}
+
+static void PrefixAdd(StrBase *base, u32 slot) {
+    StrBasePrefix *p = base->prefix;
+    if (!p)
+        return;
+
+    SString s = base->strstore[slot];
+    if (!p->nblocks)
+        PrefixInsertBlock(base, p, 0);
+
+    u32 b = PrefixBlock(base, p, s);
+    u32 pos = PrefixPos(base, p, b, s);
+
+    // split a full block in half
+    if (p->sizes[b] == STRBASE_PREFIX_BLOCK) {
+        u32 half = STRBASE_PREFIX_BLOCK / 2;
+        PrefixInsertBlock(base, p, b + 1);
+        memcpy(p->blocks[b + 1], p->blocks[b] + half, half * sizeof(u32));
+        p->sizes[b + 1] = half;
+        p->sizes[b] = half;
+        if (pos > half) {
+            b++;
+            pos -= half;
+        }
+    }
+
+    u32 *block = p->blocks[b];
+    memmove(&block[pos + 1], &block[pos], (p->sizes[b] - pos) * sizeof(u32));
+    block[pos] = slot;
+    p->sizes[b]++;
+}
+
+static void PrefixRemove(StrBase *base, u32 slot) {
+    StrBasePrefix *p = base->prefix;
+    if (!p)
+        return;
+
+    SString s = base->strstore[slot];
+    u32 b = PrefixBlock(base, p, s);
+    u32 pos = PrefixPos(base, p, b, s);
+
+    u32 *block = p->blocks[b];
+    memmove(&block[pos], &block[pos + 1], (p->sizes[b] - pos - 1) * sizeof(u32));
+    if (--p->sizes[b])
+        return;
+
+    // drop the empty block
+    Free(base->mem, block, STRBASE_PREFIX_BLOCK * sizeof(u32));
+    memmove(&p->blocks[b], &p->blocks[b + 1], (p->nblocks - b - 1) * sizeof(u32 *));
+    memmove(&p->sizes[b], &p->sizes[b + 1], (p->nblocks - b - 1) * sizeof(u32));
+    p->nblocks--;
+}
+
+static void PrefixDrop(StrBase *base) {
+    StrBasePrefix *p = base->prefix;
+    if (!p)
+        return;
+
+    for (u32 b = 0; b < p->nblocks; b++)
+        Free(base->mem, p->blocks[b], STRBASE_PREFIX_BLOCK * sizeof(u32));
+    Free(base->mem, p->blocks, p->cap * sizeof(u32 *));
+    Free(base->mem, p->sizes, p->cap * sizeof(u32));
+    Free(base->mem, p, sizeof(StrBasePrefix));
+    base->prefix = NULL;
+}
+
+u32 StrBasePrefixSearch(StrBase *base, SString prefix, StrID *out, u32 max) {
+    if (!(base->flags & STRBASE_PREFIX)) {
+        debugerr("StrBasePrefixSearch needs STRBASE_PREFIX");
+        return 0;
+    }
+    if (!base->prefix)
+        PrefixBuild(base);
+
+    StrBasePrefix *p = base->prefix;
+    if (!p->nblocks)
+        return 0;
+
+    u32 b = PrefixBlock(base, p, prefix);
+    u32 pos = PrefixPos(base, p, b, prefix);
+
+    u32 count = 0;
+    for (; b < p->nblocks && count < max; b++, pos = 0) {
+        for (; pos < p->sizes[b] && count < max; pos++) {
+            u32 slot = p->blocks[b][pos];
+            SString s = base->strstore[slot];
+            if (s.len < prefix.len || memcmp(s.data, prefix.data, prefix.len))
+                return count;
+            out[count++] = MakeStrID(slot, base->gens[slot]);
+        }
+    }
+    return count;
+}
+
+// freezing
+
+u32 StrBaseFreeze(StrBase *base, StrID *remap) {
+    u32 max = base->maxslots;
+    u32 count = 0;
+
+    PrefixEntry *entries = Alloc(base->mem, base->hashsize * sizeof(PrefixEntry));
+    StrBaseIter it = {0};
+    for (StrID id; (id = StrBaseIterNext(base, &it)) != STRBASE_INAVLID_STR;) {
+        entries[count++] = (PrefixEntry){GetStr(base, id), StrIDSlot(id)};
+    }
+    qsort(entries, count, sizeof(PrefixEntry), PrefixEntryOrder);
+
+    u32 *order = Alloc(base->mem, base->hashsize * sizeof(u32));
+    for (u32 k = 0; k < count; k++) order[k] = entries[k].slot;
+    Free(base->mem, entries, base->hashsize * sizeof(PrefixEntry));
+
+    SlotRenumber(base, order, count, remap);
+    Free(base->mem, order, base->hashsize * sizeof(u32));
+
+    if (count < max) {
+        base->freesize = 0;
+        SlotResize(base, count);
+    }
+
+    base->flags |= STRBASE_FROZEN;
+    return count;
+}
+
+// sort keys
+
+i32 StrBaseCompare(StrBase *base, StrID a, StrID b) {
+    u64 ka = base->sortkeys[StrIDSlot(a)];
+    u64 kb = base->sortkeys[StrIDSlot(b)];
+    if (ka != kb)
+        return ka < kb ? -1 : 1;
+    return SstrOrder(GetStr(base, a), GetStr(base, b));
+}
+
+typedef struct SortPair {
+    u64 key;
+    StrID id;
+} SortPair;
+
+void StrBaseSortIDs(StrBase *base, StrID *ids, u32 n) {
+    if (n < 2)
+        return;
+
+    SortPair *pairs = Alloc(base->mem, n * sizeof(SortPair));
+    SortPair *tmp = Alloc(base->mem, n * sizeof(SortPair));
+    for (u32 i = 0; i < n; i++) pairs[i] = (SortPair){base->sortkeys[StrIDSlot(ids[i])], ids[i]};
+
+    // lsd radix sort a byte at a time, bytes every key shares
+    // (short strings, common prefixes) are skipped
+    for (u32 shift = 0; shift < 64; shift += 8) {
+        u32 counts[256] = {0};
+        for (u32 i = 0; i < n; i++) counts[(pairs[i].key >> shift) & 0xff]++;
+        if (counts[(pairs[0].key >> shift) & 0xff] == n)
+            continue;
+
+        u32 sum = 0;
+        for (u32 d = 0; d < 256; d++) {
+            u32 c = counts[d];
+            counts[d] = sum;
+            sum += c;
+        }
+        for (u32 i = 0; i < n; i++) tmp[counts[(pairs[i].key >> shift) & 0xff]++] = pairs[i];
+
+        SortPair *swap = pairs;
+        pairs = tmp;
+        tmp = swap;
+    }
+
+    // ties on the key need the whole string, PrefixEntry carries
+    // the id in place of the slot here
+    PrefixEntry *run = NULL;
+    u32 runcap = 0;
+    for (u32 i = 0; i < n;) {
+        u32 end = i + 1;
+        while (end < n && pairs[end].key == pairs[i].key) end++;
+
+        u32 len = end - i;
+        if (len > 1) {
+            if (len > runcap) {
+                run = Realloc(base->mem, run, runcap * sizeof(PrefixEntry),
+                              len * sizeof(PrefixEntry));
+                runcap = len;
+            }
+            for (u32 k = 0; k < len; k++) {
+                run[k] = (PrefixEntry){GetStr(base, pairs[i + k].id), pairs[i + k].id};
+            }
+            qsort(run, len, sizeof(PrefixEntry), PrefixEntryOrder);
+            for (u32 k = 0; k < len; k++) pairs[i + k].id = run[k].slot;
+        }
+        i = end;
+    }
+    if (run)
+        Free(base->mem, run, runcap * sizeof(PrefixEntry));
+
+    for (u32 i = 0; i < n; i++) ids[i] = pairs[i].id;
+    Free(base->mem, pairs, n * sizeof(SortPair));
+    Free(base->mem, tmp, n * sizeof(SortPair));
+}
+
+// trigram index
+
+// Freed strings stay in their lists until the index is rebuilt, that
+// happens once they make up half of it. A reused slot may show up
+// twice, results are deduplicated.
+typedef struct StrBaseTrigram {
+    u32 *lists[STRBASE_TRIGRAM_BUCKETS];
+    u32 sizes[STRBASE_TRIGRAM_BUCKETS];
+    u32 caps[STRBASE_TRIGRAM_BUCKETS];
+    u64 postings;
+    u64 stale;
+} StrBaseTrigram;
+
+static u32 TrigramBucket(u8 *p) {
+    u32 tri = (u32)p[0] << 16 | (u32)p[1] << 8 | p[2];
+    return (tri * 2654435761u) % STRBASE_TRIGRAM_BUCKETS;
+}
+
+static void TrigramAdd(StrBase *base, u32 slot) {
+    StrBaseTrigram *t = base->trigram;
+    if (!t)
+        return;
+
+    SString s = base->strstore[slot];
+    for (u32 i = 0; i + 3 <= s.len; i++) {
+        u32 b = TrigramBucket((u8 *)s.data + i);
+
+        // repeats inside one string mostly come in a row
+        if (t->sizes[b] && t->lists[b][t->sizes[b] - 1] == slot)
+            continue;
+
+        if (t->sizes[b] == t->caps[b]) {
+            u32 cap = t->caps[b] ? t->caps[b] * 2 : 8;
+            t->lists[b] =
+                Realloc(base->mem, t->lists[b], t->caps[b] * sizeof(u32), cap * sizeof(u32));
+            t->caps[b] = cap;
+        }
+        t->lists[b][t->sizes[b]++] = slot;
+        t->postings++;
+    }
+}
+
+static void TrigramDrop(StrBase *base) {
+    StrBaseTrigram *t = base->trigram;
+    if (!t)
+        return;
+
+    for (u32 b = 0; b < STRBASE_TRIGRAM_BUCKETS; b++)
+        Free(base->mem, t->lists[b], t->caps[b] * sizeof(u32));
+    Free(base->mem, t, sizeof(StrBaseTrigram));
+    base->trigram = NULL;
+}
+
+static void TrigramRemove(StrBase *base, u32 slot) {
+    StrBaseTrigram *t = base->trigram;
+    if (!t)
+        return;
+
+    // the postings are left behind, at most one per trigram
+    SString s = base->strstore[slot];
+    if (s.len >= 3)
+        t->stale += s.len - 2;
+    if (t->stale * 2 > t->postings)
+        TrigramDrop(base);
+}
+
+static void TrigramBuild(StrBase *base) {
+    StrBaseTrigram *t = Alloc(base->mem, sizeof(StrBaseTrigram));
+    memset(t, 0, sizeof(StrBaseTrigram));
+    base->trigram = t;
+
+    StrBaseIter it = {0};
+    for (StrID id; (id = StrBaseIterNext(base, &it)) != STRBASE_INAVLID_STR;) {
+        TrigramAdd(base, StrIDSlot(id));
+    }
+}
+
+static bool8 SstrContains(SString s, SString sub) {
+    if (!sub.len)
+        return 1;
+
+    for (u32 i = 0; i + sub.len <= s.len; i++) {
+        u8 *at = memchr(s.data + i, sub.data[0], s.len - sub.len - i + 1);
+        if (!at)
+            return 0;
+
+        i = at - (u8 *)s.data;
+        if (memcmp(at, sub.data, sub.len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static int SlotOrder(const void *a, const void *b) {
+    u32 x = *(u32 *)a, y = *(u32 *)b;
+    return (x > y) - (x < y);
+}
+
+u32 StrBaseSubstringSearch(StrBase *base, SString sub, StrID *out, u32 max) {
+    if (!(base->flags & STRBASE_TRIGRAM)) {
+        debugerr("StrBaseSubstringSearch needs STRBASE_TRIGRAM");
+        return 0;
+    }
+
+    u32 count = 0;
+    if (sub.len < 3) {
+        StrBaseIter it = {0};
+        for (StrID id; count < max && (id = StrBaseIterNext(base, &it)) != STRBASE_INAVLID_STR;) {
+            if (SstrContains(GetStr(base, id), sub))
+                out[count++] = id;
+        }
+        return count;
+    }
+
+    if (!base->trigram)
+        TrigramBuild(base);
+    StrBaseTrigram *t = base->trigram;
+
+    // candidates start from the shortest list
+    u32 shortest = TrigramBucket((u8 *)sub.data);
+    for (u32 i = 1; i + 3 <= sub.len; i++) {
+        u32 b = TrigramBucket((u8 *)sub.data + i);
+        if (t->sizes[b] < t->sizes[shortest])
+            shortest = b;
+    }
+
+    u32 total = t->sizes[shortest];
+    if (!total)
+        return 0;
+    u32 *cand = Alloc(base->mem, total * sizeof(u32));
+    u32 ncand = 0;
+
+    // slots released by StrBaseShrink may still be listed
+    for (u32 k = 0; k < total; k++) {
+        if (t->lists[shortest][k] < base->maxslots)
+            cand[ncand++] = t->lists[shortest][k];
+    }
+
+    // intersect with the other lists through a slot bitmap
+    u32 words = BitmapWords(base->maxslots);
+    u64 *seen = Alloc(base->mem, words * sizeof(u64));
+    memset(seen, 0, words * sizeof(u64));
+    for (u32 i = 0; ncand && i + 3 <= sub.len; i++) {
+        u32 b = TrigramBucket((u8 *)sub.data + i);
+        if (b == shortest)
+            continue;
+
+        u32 *list = t->lists[b];
+        for (u32 k = 0; k < t->sizes[b]; k++) {
+            if (list[k] < base->maxslots)
+                BitmapSet(seen, list[k]);
+        }
+
+        u32 kept = 0;
+        for (u32 k = 0; k < ncand; k++) {
+            if (BitmapGet(seen, cand[k]))
+                cand[kept++] = cand[k];
+        }
+        ncand = kept;
+
+        for (u32 k = 0; k < t->sizes[b]; k++) {
+            if (list[k] < base->maxslots)
+                BitmapClear(seen, list[k]);
+        }
+    }
+    Free(base->mem, seen, words * sizeof(u64));
+
+    // stale and colliding postings fall out here
+    qsort(cand, ncand, sizeof(u32), SlotOrder);
+    for (u32 k = 0; k < ncand && count < max; k++) {
+        u32 slot = cand[k];
+        if (k && slot == cand[k - 1])
+            continue;
+        if (!BitmapGet(base->occupied, slot) || !SstrContains(base->strstore[slot], sub))
+            continue;
+        out[count++] = MakeStrID(slot, base->gens[slot]);
+    }
+
+    Free(base->mem, cand, total * sizeof(u32));
+    return count;
+}
+
+// index hooks
+
+static void IndexAdd(StrBase *base, u32 slot) {
+    PrefixAdd(base, slot);
+    TrigramAdd(base, slot);
+}
+
+static void IndexRemove(StrBase *base, u32 slot) {
+    PrefixRemove(base, slot);
+    TrigramRemove(base, slot);
+}
+
+static void IndexDrop(StrBase *base) {
+    PrefixDrop(base);
+    TrigramDrop(base);
+}
+
+void StrBaseShrink(StrBase *base) {
+    // one past the highest live slot
+    u32 top = 0;
+    for (u32 word = BitmapWords(base->maxslots); word; word--) {
+        if (base->occupied[word - 1]) {
+            top = word * 64 - __builtin_clzl(base->occupied[word - 1]);
+            break;
+        }
+    }
+
+    if (!top) {
+        // empty, drop everything but the log and the generations
+        StrBase keep = {
+            .mem = base->mem,
+            .flags = base->flags,
+            .wal = base->wal,
+            .epoch = base->epoch,
+            .gens = base->gens,
+            .gencap = base->gencap,
+        };
+        base->wal = NULL;
+        base->gens = NULL;
+        base->gencap = 0;
+
+        StrBaseFree(base);
+        *base = keep;
+        return;
+    }
+
+    if (top < base->maxslots) {
+        // rebuild the free list without the released tail
+        base->freesize = 0;
+        for (u32 i = 0; i < top; i++) {
+            if (!base->refs[i])
+                FreeSlot(base, i);
+        }
+        SlotResize(base, top);
+    }
+
+    u32 cap = HashCapFor(base->hashsize);
+    if (cap < base->hashcap)
+        HashRehash(base, cap);
+}
+
+// persistence
+
+#define STRBASE_SNAP_MAGIC 0x50414e5342525453UL // "STRBSNAP"
+#define STRBASE_WAL_MAGIC 0x4c41574253525453UL  // "STRBWAL"
+#define STRBASE_DELTA_MAGIC 0x544c454442525453UL // "STRBDELT"
+#define STRBASE_PERSIST_VERSION 1
+
+// of snapshots and deltas
+typedef struct SnapHeader {
+    u64 magic;
+    u32 version;
+    u32 epoch;
+    u32 maxslots;
+    u32 parent; // epoch a delta continues
+} SnapHeader;
+
+typedef struct WalHeader {
+    u64 magic;
+    u32 version;
+    u32 epoch; // of the snapshot the log continues
+} WalHeader;
+
+// shared by snapshots and the log, followed by len bytes
+typedef struct RecordHeader {
+    u32 check; // over the rest of the header and the bytes
+    u8 type;
+    u8 gen;
+    u16 pad;
+    u32 slot;
+    u32 refs;
+    u32 len;
+} RecordHeader;
+
+// buffered writer, also used for snapshots
+typedef struct StrBaseWal {
+    file f;
+    bool8 failed;
+    u32 size;
+    u8 buf[STRBASE_WAL_BUFFER];
+} StrBaseWal;
+
+static void WalFlush(StrBaseWal *w) {
+    if (w->size && filewrite(&w->f, (SString){.len = w->size, .data = (i8 *)w->buf}) != w->size)
+        w->failed = 1;
+    w->size = 0;
+}
+
+static void WalPut(StrBaseWal *w, void *data, u32 size) {
+    if (!size)
+        return;
+    if (w->size + size > STRBASE_WAL_BUFFER)
+        WalFlush(w);
+
+    if (size > STRBASE_WAL_BUFFER) {
+        if (filewrite(&w->f, (SString){.len = size, .data = data}) != size)
+            w->failed = 1;
+        return;
+    }
+
+    memcpy(w->buf + w->size, data, size);
+    w->size += size;
+}
+
+// FNV-1a, chained over the header and the bytes
+static u32 RecordCheck(RecordHeader *h, u8 *bytes) {
+    u32 hash = 0x811c9dc5;
+    u8 *p = &h->type;
+    for (u32 i = 0; i < sizeof(RecordHeader) - sizeof(u32); i++) hash = (hash ^ p[i]) * 0x01000193;
+    for (u32 i = 0; i < h->len; i++) hash = (hash ^ bytes[i]) * 0x01000193;
+    return hash;
+}
+
+static void RecordPut(StrBaseWal *w, StrBase *base, strbase_record type, u32 slot) {
+    SString s = type == STRBASE_REC_ADD ? base->strstore[slot] : (SString){0};
+    RecordHeader h = {
+        .type = type,
+        .gen = base->gens[slot],
+        .slot = slot,
+        .refs = type == STRBASE_REC_FREE ? 0 : base->refs[slot],
+        .len = s.len,
+    };
+    h.check = RecordCheck(&h, (u8 *)s.data);
+
+    WalPut(w, &h, sizeof(h));
+    WalPut(w, s.data, s.len);
+}
+
+static void WalRecord(StrBase *base, strbase_record type, u32 slot) {
+    RecordPut(base->wal, base, type, slot);
+}
+
+// writes a record straight into its slot, the free list and the
+// table are rebuilt by RestoreFinish
+static void RecordApply(StrBase *base, RecordHeader *h, u8 *bytes) {
+    u32 slot = h->slot;
+    if (h->type == STRBASE_REC_REFS) {
+        // only follows an ADD of the same slot
+        bool8 live = slot < base->maxslots && BitmapGet(base->occupied, slot);
+        if (live && base->gens[slot] == h->gen) {
+            base->refs[slot] = h->refs;
+            BitmapSet(base->dirty, slot);
+        }
+        return;
+    }
+
+    if (slot >= base->maxslots) {
+        u32 newmax = base->maxslots ? base->maxslots : STRBASE_MIN_SIZE;
+        while (newmax <= slot)
+            newmax = newmax > STRBASE_MAX_SLOTS / 2 ? STRBASE_MAX_SLOTS : newmax * 2;
+        SlotResize(base, newmax);
+    }
+
+    if (BitmapGet(base->occupied, slot))
+        SlotRelease(base, slot);
+    BitmapClear(base->borrowed, slot);
+
+    if (h->type == STRBASE_REC_ADD) {
+        SString s = {.len = h->len, .data = (i8 *)bytes};
+        base->strstore[slot] = Sstrdup(base->mem, s);
+        base->refs[slot] = h->refs;
+        base->hashes[slot] = FNVHash32(bytes, h->len);
+        base->sortkeys[slot] = SortKey(s);
+        BitmapSet(base->occupied, slot);
+    } else {
+        base->strstore[slot] = (SString){0};
+        base->refs[slot] = 0;
+        BitmapClear(base->occupied, slot);
+    }
+    base->gens[slot] = h->gen;
+    BitmapSet(base->dirty, slot);
+}
+
+// reads the record at off, 0 if it is torn or corrupt
+static bool8 RecordNext(u8 *data, u64 size, u64 off, RecordHeader *h) {
+    if (size - off < sizeof(RecordHeader))
+        return 0;
+    memcpy(h, data + off, sizeof(RecordHeader));
+
+    return size - off - sizeof(RecordHeader) >= h->len && h->slot < STRBASE_MAX_SLOTS &&
+           (h->type == STRBASE_REC_ADD || h->type == STRBASE_REC_FREE ||
+            (h->type == STRBASE_REC_REFS && !h->len)) &&
+           RecordCheck(h, data + off + sizeof(RecordHeader)) == h->check;
+}
+
+// applies records until the data ends or one is torn or corrupt,
+// returns the number of bytes that were applied
+static u64 RecordsApply(StrBase *base, u8 *data, u64 size) {
+    u64 off = 0;
+    RecordHeader h;
+    while (RecordNext(data, size, off, &h)) {
+        RecordApply(base, &h, data + off + sizeof(h));
+        off += sizeof(h) + h.len;
+    }
+    return off;
+}
+
+// free list and table from the slots alone
+static void RestoreFinish(StrBase *base) {
+    IndexDrop(base);
+    FreeListRebuild(base, base->maxslots);
+    u32 count = base->maxslots - base->freesize;
+
+    Free(base->mem, base->stridx, base->hashcap * sizeof(u32));
+    Free(base->mem, base->meta, base->hashcap * sizeof(u32));
+    base->stridx = NULL;
+    base->meta = NULL;
+    base->hashcap = 0;
+
+    HashRehash(base, HashCapFor(count));
+    for (u32 i = 0; i < base->maxslots; i++) {
+        if (BitmapGet(base->occupied, i))
+            HashPlace(base, i);
+    }
+    base->hashsize = count;
+}
+
+static char *PersistName(char *buf, SString filename, const char *suffix) {
+    sformat((SString){.len = PATH_MAX - 8, .data = (i8 *)buf}, "%s", filename);
+    strcat(buf, suffix);
+    return buf;
+}
+
+static void DirtyClear(StrBase *base) {
+    if (base->dirty)
+        memset(base->dirty, 0, BitmapWords(base->maxslots) * sizeof(u64));
+}
+
+// writes an image, or a delta of the dirty slots, and starts the
+// next epoch
+static bool8 SnapWrite(StrBase *base, SString filename, bool8 delta) {
+    char name[PATH_MAX + 1] = {0};
+    char tmp[PATH_MAX + 1] = {0};
+    PersistName(name, filename, "");
+    PersistName(tmp, filename, ".tmp");
+
+    StrBaseWal *w = Alloc(base->mem, sizeof(StrBaseWal));
+    *w = (StrBaseWal){0};
+    w->f = fileopen((SString){.len = strlen(tmp), .data = (i8 *)tmp},
+                    FILE_WRITE | FILE_CREAT | FILE_TRUNC);
+    if (w->f.handle == (u64)-1) {
+        Free(base->mem, w, sizeof(StrBaseWal));
+        return 0;
+    }
+
+    SnapHeader hdr = {
+        .magic = delta ? STRBASE_DELTA_MAGIC : STRBASE_SNAP_MAGIC,
+        .version = STRBASE_PERSIST_VERSION,
+        .epoch = base->epoch + 1,
+        .maxslots = base->maxslots,
+        .parent = base->epoch,
+    };
+    WalPut(w, &hdr, sizeof(hdr));
+
+    // free slots only matter once their generation moved on,
+    // a delta has to carry every free too
+    for (u32 i = 0; i < base->maxslots; i++) {
+        if (delta && !BitmapGet(base->dirty, i))
+            continue;
+
+        if (BitmapGet(base->occupied, i))
+            RecordPut(w, base, STRBASE_REC_ADD, i);
+        else if (delta || base->gens[i])
+            RecordPut(w, base, STRBASE_REC_FREE, i);
+    }
+
+    // released slots past the end keep their generation
+    for (u32 i = base->maxslots; i < base->gencap; i++) {
+        if (base->gens[i])
+            RecordPut(w, base, STRBASE_REC_FREE, i);
+    }
+
+    WalFlush(w);
+    filesync(&w->f);
+    fileclose(w->f);
+
+    bool8 ok = !w->failed && rename(tmp, name) == 0;
+    Free(base->mem, w, sizeof(StrBaseWal));
+    if (!ok) {
+        debugerr("Failed to save StrBase to %s", filename);
+        remove(tmp);
+        return 0;
+    }
+
+    base->epoch = hdr.epoch;
+    DirtyClear(base);
+    return 1;
+}
+
+// empties the log, everything in it is saved
+static bool8 WalReset(StrBase *base) {
+    StrBaseWal *w = base->wal;
+    if (!w)
+        return 1;
+
+    w->size = 0;
+    if (ftruncate(w->f.handle, 0) || lseek(w->f.handle, 0, SEEK_SET) < 0) {
+        w->failed = 1;
+        return 0;
+    }
+
+    WalHeader hdr = {
+        .magic = STRBASE_WAL_MAGIC,
+        .version = STRBASE_PERSIST_VERSION,
+        .epoch = base->epoch,
+    };
+    WalPut(w, &hdr, sizeof(hdr));
+    StrBaseWalSync(base);
+    return !w->failed;
+}
+
+bool8 StrBaseSave(StrBase *base, SString filename) { return SnapWrite(base, filename, 0); }
+
+bool8 StrBaseLoad(StrBase *base, SString filename) {
+    if (base->maxslots) {
+        debugerr("StrBaseLoad needs an empty base");
+        return 0;
+    }
+
+    LString map = filemap(filename, FILEMAP_SEQUENTIAL);
+    SnapHeader hdr = {0};
+    if (map.len >= sizeof(hdr))
+        memcpy(&hdr, map.data, sizeof(hdr));
+    if (hdr.magic != STRBASE_SNAP_MAGIC || hdr.version != STRBASE_PERSIST_VERSION ||
+        hdr.maxslots > STRBASE_MAX_SLOTS) {
+        debugerr("Not a StrBase snapshot: %s", filename);
+        fileunmap(map);
+        return 0;
+    }
+
+    if (hdr.maxslots)
+        SlotResize(base, hdr.maxslots);
+
+    u64 size = map.len - sizeof(hdr);
+    u64 applied = RecordsApply(base, (u8 *)map.data + sizeof(hdr), size);
+    fileunmap(map);
+
+    if (applied != size) {
+        debugerr("Corrupt StrBase snapshot: %s", filename);
+        StrBaseFree(base);
+        *base = (StrBase){.mem = base->mem, .flags = base->flags};
+        return 0;
+    }
+
+    // records past the end only carried generations
+    if (base->maxslots > hdr.maxslots)
+        SlotResize(base, hdr.maxslots);
+    RestoreFinish(base);
+    base->epoch = hdr.epoch;
+    DirtyClear(base);
+    return 1;
+}
+
+bool8 StrBaseSaveDelta(StrBase *base, SString filename) {
+    return SnapWrite(base, filename, 1) && WalReset(base);
+}
+
+bool8 StrBaseLoadDelta(StrBase *base, SString filename) {
+    LString map = filemap(filename, FILEMAP_SEQUENTIAL);
+    SnapHeader hdr = {0};
+    if (map.len >= sizeof(hdr))
+        memcpy(&hdr, map.data, sizeof(hdr));
+    if (hdr.magic != STRBASE_DELTA_MAGIC || hdr.version != STRBASE_PERSIST_VERSION ||
+        hdr.maxslots > STRBASE_MAX_SLOTS) {
+        debugerr("Not a StrBase delta: %s", filename);
+        fileunmap(map);
+        return 0;
+    }
+    if (hdr.parent != base->epoch) {
+        debugerr("%s does not continue the loaded snapshot", filename);
+        fileunmap(map);
+        return 0;
+    }
+
+    // check everything first so a bad delta leaves base untouched
+    u8 *data = (u8 *)map.data + sizeof(hdr);
+    u64 size = map.len - sizeof(hdr);
+    u64 off = 0;
+    RecordHeader h;
+    while (RecordNext(data, size, off, &h)) off += sizeof(h) + h.len;
+    if (off != size) {
+        debugerr("Corrupt StrBase delta: %s", filename);
+        fileunmap(map);
+        return 0;
+    }
+
+    // slots released by a compaction or shrink since the parent
+    for (u32 i = hdr.maxslots; i < base->maxslots; i++) {
+        if (BitmapGet(base->occupied, i))
+            SlotRelease(base, i);
+        BitmapClear(base->occupied, i);
+        BitmapClear(base->borrowed, i);
+    }
+    if (hdr.maxslots != base->maxslots)
+        SlotResize(base, hdr.maxslots);
+
+    RecordsApply(base, data, size);
+    fileunmap(map);
+
+    if (base->maxslots > hdr.maxslots)
+        SlotResize(base, hdr.maxslots);
+    RestoreFinish(base);
+    base->epoch = hdr.epoch;
+    DirtyClear(base);
+    return 1;
+}
+
+bool8 StrBaseWalOpen(StrBase *base, SString filename) {
+    if (base->wal)
+        StrBaseWalClose(base);
+
+    file f = fileopen(filename, FILE_READ | FILE_WRITE | FILE_CREAT);
+    if (f.handle == (u64)-1)
+        return 0;
+
+    // replay whatever the log holds for the loaded snapshot
+    u64 keep = 0;
+    LString map = filemap(filename, FILEMAP_SEQUENTIAL);
+    if (map.len >= sizeof(WalHeader)) {
+        WalHeader hdr;
+        memcpy(&hdr, map.data, sizeof(hdr));
+
+        bool8 valid = hdr.magic == STRBASE_WAL_MAGIC && hdr.version == STRBASE_PERSIST_VERSION;
+        if (!valid || hdr.epoch > base->epoch) {
+            debugerr("%s does not continue the loaded snapshot", filename);
+            fileunmap(map);
+            fileclose(f);
+            return 0;
+        }
+
+        // an older log was already folded into the snapshot
+        if (hdr.epoch == base->epoch) {
+            u64 size = map.len - sizeof(hdr);
+            keep = sizeof(hdr) + RecordsApply(base, (u8 *)map.data + sizeof(hdr), size);
+            RestoreFinish(base);
+        }
+    }
+    fileunmap(map);
+
+    // drop a torn tail so new records follow the last good one
+    if (ftruncate(f.handle, keep) || lseek(f.handle, keep, SEEK_SET) < 0) {
+        debugerr("Failed to truncate %s", filename);
+        fileclose(f);
+        return 0;
+    }
+
+    StrBaseWal *w = Alloc(base->mem, sizeof(StrBaseWal));
+    *w = (StrBaseWal){.f = f};
+    if (!keep) {
+        WalHeader hdr = {
+            .magic = STRBASE_WAL_MAGIC,
+            .version = STRBASE_PERSIST_VERSION,
+            .epoch = base->epoch,
+        };
+        WalPut(w, &hdr, sizeof(hdr));
+    }
+
+    base->wal = w;
+    return 1;
+}
+
+void StrBaseWalSync(StrBase *base) {
+    if (!base->wal)
+        return;
+    WalFlush(base->wal);
+    filesync(&base->wal->f);
+}
+
+bool8 StrBaseCheckpoint(StrBase *base, SString snapshot) {
+    return StrBaseSave(base, snapshot) && WalReset(base);
+}
+
+void StrBaseWalClose(StrBase *base) {
+    if (!base->wal)
+        return;
+
+    StrBaseWalSync(base);
+    fileclose(base->wal->f);
+    Free(base->mem, base->wal, sizeof(StrBaseWal));
+    base->wal = NULL;
+}
+
+void StrBaseFree(StrBase *base) {
+    StrBaseWalClose(base);
+    IndexDrop(base);
+
+    StrBaseIter it = {0};
+    for (StrID id; (id = StrBaseIterNext(base, &it)) != STRBASE_INAVLID_STR;) {
+        SlotRelease(base, StrIDSlot(id));
     }
 
-    Free(base->mem, base->strstore, base->maxslots * sizeof(SString));
-    Free(base->mem, base->refs, base->maxslots * sizeof(u32));
-    Free(base->mem, base->freeslots, base->maxslots * sizeof(u32));
+    SlotArrayFree(base, base->strstore, sizeof(SString), base->maxslots);
+    SlotArrayFree(base, base->refs, sizeof(u32), base->maxslots);
+    SlotArrayFree(base, base->hashes, sizeof(u32), base->maxslots);
+    SlotArrayFree(base, base->sortkeys, sizeof(u64), base->maxslots);
+    SlotArrayFree(base, base->gens, sizeof(u8), base->gencap);
+    SlotArrayFree(base, base->occupied, 1, BitmapWords(base->maxslots) * sizeof(u64));
+    SlotArrayFree(base, base->borrowed, 1, BitmapWords(base->maxslots) * sizeof(u64));
+    SlotArrayFree(base, base->dirty, 1, BitmapWords(base->maxslots) * sizeof(u64));
+    SlotArrayFree(base, base->freeslots, sizeof(u32), base->maxslots);
 
     Free(base->mem, base->stridx, base->hashcap * sizeof(u32));
     Free(base->mem, base->meta, base->hashcap * sizeof(u32));
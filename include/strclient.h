@@ -0,0 +1,303 @@
+#ifndef STRCLIENT_H
+#define STRCLIENT_H
+
+#include <cutils.h>
+#include <strbase.h>
+
+/*
+    Client for the strbased interning daemon
+
+    Calls are queued and coalesced into one frame per run of the
+    same operation, StrClientFlush sends everything in a single
+    write and fills in the results. Pointers handed to the queue
+    functions have to stay valid until the flush. A flush also
+    happens on its own once STRCLIENT_FLUSH_BYTES are queued.
+
+    Wire format, little endian, every frame is a StrWireHeader
+    followed by bytes of payload:
+
+        INTERN, LOOKUP   count * (u32 len, len bytes)
+        RELEASE, GET     count * StrID
+
+    Every request frame is answered in order by a frame with the
+    same op and count:
+
+        INTERN, LOOKUP   count * StrID
+        RELEASE          empty
+        GET              count * (u32 len, len bytes)
+
+    except that a GET answer larger than STRWIRE_MAX_FRAME comes
+    as several frames whose counts add up to the request's.
+
+    Needs STRCLIENT_IMPL in exactly one translation unit.
+*/
+
+#ifndef STRCLIENT_FLUSH_BYTES
+#define STRCLIENT_FLUSH_BYTES (1 << 20)
+#endif
+
+// larger frames are a protocol error
+#define STRWIRE_MAX_FRAME (64u << 20)
+
+typedef enum strwire_op {
+    STRWIRE_INTERN = 1,
+    STRWIRE_LOOKUP = 2,
+    STRWIRE_RELEASE = 3,
+    STRWIRE_GET = 4,
+} strwire_op;
+
+typedef struct StrWireHeader {
+    u32 op;
+    u32 count;
+    u32 bytes; // payload size
+} StrWireHeader;
+
+typedef struct StrClientDest {
+    u32 op;
+    void *dst; // StrID * or SString *
+} StrClientDest;
+
+typedef struct StrClient {
+    int fd; // -1 if not connected
+    Allocator mem;
+
+    u8 *out;
+    u64 outsize;
+    u64 outcap;
+    u64 frame; // offset of the open frame, -1 if there is none
+    u32 frames;
+
+    StrClientDest *dests;
+    u32 ndests;
+    u32 destcap;
+
+    u8 *in;
+    u64 incap;
+} StrClient;
+
+StrClient StrClientConnect(SString path, Allocator mem);
+void StrClientClose(StrClient *c);
+
+// *id is written by the next flush, id may be NULL
+void StrClientIntern(StrClient *c, SString s, StrID *id);
+void StrClientLookup(StrClient *c, SString s, StrID *id);
+void StrClientRelease(StrClient *c, StrID id);
+
+// *out receives a copy allocated from the client's allocator,
+// {0} for stale IDs. out may be NULL
+void StrClientGet(StrClient *c, StrID id, SString *out);
+
+// sends the queue and waits for every answer, 0 if the
+// connection failed (results are left unwritten)
+bool8 StrClientFlush(StrClient *c);
+
+#ifdef STRCLIENT_IMPL
+#include "cutils.h"
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+StrClient StrClientConnect(SString path, Allocator mem) {
+    StrClient c = {.fd = -1, .mem = mem, .frame = -1};
+
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (path.len >= sizeof(addr.sun_path)) {
+        debugerr("Socket path too long: %s", path);
+        return c;
+    }
+    memcpy(addr.sun_path, path.data, path.len);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        debugerr("Failed to connect to %s", path);
+        if (fd >= 0)
+            close(fd);
+        return c;
+    }
+
+    c.fd = fd;
+    return c;
+}
+
+void StrClientClose(StrClient *c) {
+    if (c->fd >= 0)
+        close(c->fd);
+    Free(c->mem, c->out, c->outcap);
+    Free(c->mem, c->dests, c->destcap * sizeof(StrClientDest));
+    Free(c->mem, c->in, c->incap);
+    *c = (StrClient){.fd = -1, .mem = c->mem, .frame = -1};
+}
+
+static u8 *ClientOut(StrClient *c, u64 size) {
+    if (c->outsize + size > c->outcap) {
+        u64 cap = c->outcap ? c->outcap : PAGE_SIZE;
+        while (cap < c->outsize + size) cap *= 2;
+        c->out = Realloc(c->mem, c->out, c->outcap, cap);
+        c->outcap = cap;
+    }
+
+    u8 *p = c->out + c->outsize;
+    c->outsize += size;
+    return p;
+}
+
+// appends one item to the open frame of op, starting a new one if needed.
+// every op but RELEASE is answered per item and gets a destination,
+// NULL ones just keep the results in step. headers after a string
+// item are unaligned so they only go through memcpy
+static u8 *ClientItem(StrClient *c, u32 op, u32 size, void *dst) {
+    if (c->outsize >= STRCLIENT_FLUSH_BYTES)
+        StrClientFlush(c);
+
+    StrWireHeader hdr = {0};
+    if (c->frame != (u64)-1)
+        memcpy(&hdr, c->out + c->frame, sizeof(hdr));
+    if (c->frame == (u64)-1 || hdr.op != op || hdr.bytes + size > STRWIRE_MAX_FRAME) {
+        c->frame = c->outsize;
+        hdr = (StrWireHeader){.op = op};
+        ClientOut(c, sizeof(StrWireHeader));
+        c->frames++;
+    }
+
+    u8 *p = ClientOut(c, size);
+    hdr.count++;
+    hdr.bytes += size;
+    memcpy(c->out + c->frame, &hdr, sizeof(hdr));
+
+    if (op != STRWIRE_RELEASE) {
+        if (c->ndests == c->destcap) {
+            u32 cap = c->destcap ? c->destcap * 2 : 64;
+            c->dests = Realloc(c->mem, c->dests, c->destcap * sizeof(StrClientDest),
+                               cap * sizeof(StrClientDest));
+            c->destcap = cap;
+        }
+        c->dests[c->ndests++] = (StrClientDest){.op = op, .dst = dst};
+    }
+    return p;
+}
+
+static void ClientString(StrClient *c, u32 op, SString s, StrID *id) {
+    u8 *p = ClientItem(c, op, sizeof(u32) + s.len, id);
+    memcpy(p, &s.len, sizeof(u32));
+    memcpy(p + sizeof(u32), s.data, s.len);
+}
+
+void StrClientIntern(StrClient *c, SString s, StrID *id) { ClientString(c, STRWIRE_INTERN, s, id); }
+
+void StrClientLookup(StrClient *c, SString s, StrID *id) { ClientString(c, STRWIRE_LOOKUP, s, id); }
+
+void StrClientRelease(StrClient *c, StrID id) {
+    memcpy(ClientItem(c, STRWIRE_RELEASE, sizeof(StrID), NULL), &id, sizeof(StrID));
+}
+
+void StrClientGet(StrClient *c, StrID id, SString *out) {
+    memcpy(ClientItem(c, STRWIRE_GET, sizeof(StrID), out), &id, sizeof(StrID));
+}
+
+static bool8 ClientSend(int fd, u8 *data, u64 size) {
+    while (size) {
+        i64 sent = write(fd, data, size);
+        if (sent <= 0)
+            return 0;
+        data += sent;
+        size -= sent;
+    }
+    return 1;
+}
+
+static bool8 ClientRecv(int fd, u8 *data, u64 size) {
+    while (size) {
+        i64 got = read(fd, data, size);
+        if (got <= 0)
+            return 0;
+        data += got;
+        size -= got;
+    }
+    return 1;
+}
+
+// writes the results of one reply frame, next is the first of its
+// destinations
+static void ClientResults(StrClient *c, StrWireHeader *hdr, u32 next, u32 ndests) {
+    if (hdr->op == STRWIRE_RELEASE)
+        return;
+
+    u8 *p = c->in;
+    for (u32 i = 0; i < hdr->count && next < ndests; i++, next++) {
+        StrClientDest *d = &c->dests[next];
+        if (hdr->op != STRWIRE_GET) {
+            if (d->dst)
+                memcpy(d->dst, p, sizeof(StrID));
+            p += sizeof(StrID);
+            continue;
+        }
+
+        SString *out = d->dst;
+        u32 len;
+        memcpy(&len, p, sizeof(u32));
+        p += sizeof(u32);
+
+        if (out)
+            *out = (SString){0};
+        if (out && len) {
+            *out = (SString){.len = len, .data = Alloc(c->mem, len)};
+            memcpy(out->data, p, len);
+        }
+        p += len;
+    }
+}
+
+bool8 StrClientFlush(StrClient *c) {
+    u32 frames = c->frames;
+    u32 ndests = c->ndests;
+    bool8 ok = c->fd >= 0 && ClientSend(c->fd, c->out, c->outsize);
+
+    c->outsize = 0;
+    c->frame = -1;
+    c->frames = 0;
+    c->ndests = 0;
+
+    // c->out still holds the requests, their counts say how many
+    // answers to wait for
+    u64 off = 0;
+    u32 next = 0;
+    for (u32 f = 0; ok && f < frames; f++) {
+        StrWireHeader req;
+        memcpy(&req, c->out + off, sizeof(req));
+        off += sizeof(req) + req.bytes;
+
+        // GET answers are split rather than go past STRWIRE_MAX_FRAME
+        for (u32 got = 0; got < req.count;) {
+            StrWireHeader hdr;
+            if (!ClientRecv(c->fd, (u8 *)&hdr, sizeof(hdr)) || hdr.bytes > STRWIRE_MAX_FRAME ||
+                hdr.op != req.op || !hdr.count || hdr.count > req.count - got) {
+                ok = 0;
+                break;
+            }
+
+            if (hdr.bytes > c->incap) {
+                u64 cap = c->incap ? c->incap : PAGE_SIZE;
+                while (cap < hdr.bytes) cap *= 2;
+                c->in = Realloc(c->mem, c->in, c->incap, cap);
+                c->incap = cap;
+            }
+            if (!ClientRecv(c->fd, c->in, hdr.bytes)) {
+                ok = 0;
+                break;
+            }
+
+            ClientResults(c, &hdr, next, ndests);
+            if (hdr.op != STRWIRE_RELEASE)
+                next += hdr.count;
+            got += hdr.count;
+        }
+    }
+
+    if (!ok)
+        debugerr("Lost connection to strbased");
+    return ok;
+}
+
+#endif
+#endif
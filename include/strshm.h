@@ -0,0 +1,339 @@
+#ifndef STRSHM_H
+#define STRSHM_H
+
+#include <cutils.h>
+#include <strbase.h>
+
+/*
+    Shared memory string table
+
+    A fixed capacity, append only string table laid out in one
+    contiguous region with offsets instead of pointers, so the
+    same pages can be mapped by many processes at different
+    addresses. There is one writer, readers look strings up
+    without locks and retry when they overlap a write (seqlock).
+    IDs are slot indices and never change, StrShmGet does not
+    need the seqlock since slots and bytes are never rewritten.
+
+    Like StrBase this needs Cutils and STRSHM_IMPL in exactly
+    one translation unit, it does not need STRBASE_IMPL.
+*/
+
+#define STRSHM_MAGIC 0x314d485352545353UL // "SSTRSHM1"
+
+typedef struct StrShmSlot {
+    u64 off; // into the arena
+    u32 len;
+    u32 hash;
+} StrShmSlot;
+
+// everything past the header is addressed relative to the region
+typedef struct StrShmHeader {
+    u64 magic;
+    u64 size; // of the whole region
+    u32 seq;  // odd while the writer is moving table entries
+
+    u32 hashcap;
+    u32 hashsize; // also the number of used slots
+    u32 maxslots;
+
+    u64 arenacap;
+    u64 arenaused;
+
+    u64 stridxoff;
+    u64 metaoff;
+    u64 slotoff;
+    u64 arenaoff;
+} StrShmHeader;
+
+typedef struct StrShm {
+    StrShmHeader *hdr; // NULL if create or open failed
+    int fd;
+    bool8 writer;
+} StrShm;
+
+// Creates a region for up to maxstrings strings and arenabytes of
+// string data. An empty name gives an anonymous memfd region, its
+// fd can be handed to other processes (StrShmOpenFd), a named one
+// lives under /dev/shm until StrShmUnlink. Creating a name that is
+// taken replaces it, existing mappings keep the old region.
+StrShm StrShmCreate(SString name, u32 maxstrings, u64 arenabytes);
+
+// maps an existing region read only
+StrShm StrShmOpen(SString name);
+StrShm StrShmOpenFd(int fd);
+
+void StrShmClose(StrShm *shm);
+void StrShmUnlink(SString name);
+
+// writer only, returns STRBASE_INAVLID_STR once the region is full
+StrID StrShmAdd(StrShm *shm, SString s);
+
+// STRBASE_INAVLID_STR if s is not in the table
+StrID StrShmFind(StrShm *shm, SString s);
+
+// points into the shared mapping, {0} for unknown IDs
+SString StrShmGet(StrShm *shm, StrID id);
+
+// Adds every live string of base, remap may be NULL, otherwise it
+// needs base->maxslots entries and receives the shared ID of every
+// base slot. Returns the number of strings that fit.
+u32 StrShmExport(StrShm *shm, StrBase *base, StrID *remap);
+
+#ifdef STRSHM_IMPL
+#include "cutils.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define ShmAlign(x) (((x) + 63) & ~(u64)63)
+
+#define ShmStridx(hdr) ((u32 *)((u8 *)(hdr) + (hdr)->stridxoff))
+#define ShmMeta(hdr) ((i32 *)((u8 *)(hdr) + (hdr)->metaoff))
+#define ShmSlots(hdr) ((StrShmSlot *)((u8 *)(hdr) + (hdr)->slotoff))
+#define ShmArena(hdr) ((i8 *)(hdr) + (hdr)->arenaoff)
+
+static int ShmName(SString name, char *buf) {
+    sformat((SString){.len = PATH_MAX, .data = (i8 *)buf}, "%s", name);
+    return name.len;
+}
+
+static StrShm ShmMap(int fd, u64 size, bool8 writer) {
+    int prot = writer ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *region = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+    if (region == MAP_FAILED) {
+        debugerr("Failed to map StrShm region");
+        close(fd);
+        return (StrShm){.fd = -1};
+    }
+    return (StrShm){.hdr = region, .fd = fd, .writer = writer};
+}
+
+StrShm StrShmCreate(SString name, u32 maxstrings, u64 arenabytes) {
+    char buf[PATH_MAX + 1] = {0};
+
+    int fd;
+    if (name.len) {
+        // a region of the same name is unlinked rather than
+        // truncated, processes that still map it keep their object
+        ShmName(name, buf);
+        shm_unlink(buf);
+        fd = shm_open(buf, O_RDWR | O_CREAT | O_EXCL, 0666);
+    } else {
+        fd = syscall(SYS_memfd_create, "strshm", 0);
+    }
+    if (fd < 0) {
+        debugerr("Failed to create StrShm region %s", name);
+        return (StrShm){.fd = -1};
+    }
+
+    // same load factor as StrBase
+    u32 cap = STRBASE_MIN_SIZE;
+    while (maxstrings >= cap * STRBASE_LOAD_MAX) cap *= 2;
+
+    StrShmHeader hdr = {
+        .magic = STRSHM_MAGIC,
+        .hashcap = cap,
+        .maxslots = maxstrings,
+        .arenacap = arenabytes,
+    };
+    hdr.stridxoff = ShmAlign(sizeof(StrShmHeader));
+    hdr.metaoff = ShmAlign(hdr.stridxoff + (u64)cap * sizeof(u32));
+    hdr.slotoff = ShmAlign(hdr.metaoff + (u64)cap * sizeof(i32));
+    hdr.arenaoff = ShmAlign(hdr.slotoff + (u64)maxstrings * sizeof(StrShmSlot));
+    hdr.size = hdr.arenaoff + arenabytes;
+
+    if (ftruncate(fd, hdr.size)) {
+        debugerr("Failed to size StrShm region");
+        close(fd);
+        return (StrShm){.fd = -1};
+    }
+
+    StrShm shm = ShmMap(fd, hdr.size, 1);
+    if (!shm.hdr)
+        return shm;
+
+    // fresh pages are zero, only the table needs marking empty
+    *shm.hdr = hdr;
+    memset(ShmMeta(shm.hdr), -1, (u64)cap * sizeof(i32));
+    return shm;
+}
+
+StrShm StrShmOpenFd(int fd) {
+    StrShmHeader hdr;
+    if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || hdr.magic != STRSHM_MAGIC) {
+        debugerr("Not a StrShm region");
+        close(fd);
+        return (StrShm){.fd = -1};
+    }
+    return ShmMap(fd, hdr.size, 0);
+}
+
+StrShm StrShmOpen(SString name) {
+    char buf[PATH_MAX + 1] = {0};
+    ShmName(name, buf);
+
+    int fd = shm_open(buf, O_RDONLY, 0);
+    if (fd < 0) {
+        debugerr("Failed to open StrShm region %s", name);
+        return (StrShm){.fd = -1};
+    }
+    return StrShmOpenFd(fd);
+}
+
+void StrShmClose(StrShm *shm) {
+    if (shm->hdr)
+        munmap(shm->hdr, shm->hdr->size);
+    if (shm->fd >= 0)
+        close(shm->fd);
+    *shm = (StrShm){.fd = -1};
+}
+
+void StrShmUnlink(SString name) {
+    char buf[PATH_MAX + 1] = {0};
+    ShmName(name, buf);
+    shm_unlink(buf);
+}
+
+// probes the table, the caller takes care of the seqlock.
+// entries may be torn under a concurrent write so every
+// index is bounds checked before it is followed
+static StrID ShmProbe(StrShmHeader *hdr, SString s, u32 hash) {
+    u32 *stridx = ShmStridx(hdr);
+    i32 *meta = ShmMeta(hdr);
+    StrShmSlot *slots = ShmSlots(hdr);
+    u32 mask = hdr->hashcap - 1;
+
+    u32 idx = hash & mask;
+    for (u32 counter = 0; counter < hdr->hashcap; counter++) {
+        i32 m = meta[idx];
+        if (m == STRBASE_INAVLID_STR || (u32)m < counter)
+            return STRBASE_INAVLID_STR;
+
+        u32 slot = stridx[idx];
+        if (slot < hdr->maxslots) {
+            StrShmSlot e = slots[slot];
+            if (e.hash == hash && e.len == s.len && e.off + e.len <= hdr->arenacap &&
+                memcmp(ShmArena(hdr) + e.off, s.data, s.len) == 0)
+                return slot;
+        }
+        idx = (idx + 1) & mask;
+    }
+    return STRBASE_INAVLID_STR;
+}
+
+StrID StrShmFind(StrShm *shm, SString s) {
+    StrShmHeader *hdr = shm->hdr;
+    u32 hash = FNVHash32((u8 *)s.data, s.len);
+
+    while (1) {
+        u32 seq = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+
+        StrID id = ShmProbe(hdr, s, hash);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&hdr->seq, __ATOMIC_RELAXED) == seq)
+            return id;
+    }
+}
+
+SString StrShmGet(StrShm *shm, StrID id) {
+    StrShmHeader *hdr = shm->hdr;
+    if (id >= __atomic_load_n(&hdr->hashsize, __ATOMIC_ACQUIRE))
+        return (SString){0};
+
+    StrShmSlot e = ShmSlots(hdr)[id];
+    return (SString){.len = e.len, .data = ShmArena(hdr) + e.off};
+}
+
+static StrID ShmInsert(StrShm *shm, SString s, u32 hash) {
+    StrShmHeader *hdr = shm->hdr;
+
+    StrID found = ShmProbe(hdr, s, hash);
+    if (found != STRBASE_INAVLID_STR)
+        return found;
+
+    if (hdr->hashsize == hdr->maxslots || hdr->arenaused + s.len > hdr->arenacap)
+        return STRBASE_INAVLID_STR;
+
+    // bytes and slot first, readers cannot reach them yet
+    u32 slot = hdr->hashsize;
+    memcpy(ShmArena(hdr) + hdr->arenaused, s.data, s.len);
+    ShmSlots(hdr)[slot] = (StrShmSlot){.off = hdr->arenaused, .len = s.len, .hash = hash};
+    hdr->arenaused += s.len;
+
+    __atomic_store_n(&hdr->seq, hdr->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    // robin hood insert
+    u32 *stridx = ShmStridx(hdr);
+    i32 *meta = ShmMeta(hdr);
+    u32 mask = hdr->hashcap - 1;
+
+    u32 key = slot;
+    u32 counter = 0;
+    u32 idx = hash & mask;
+    for (u32 i = 0; i < hdr->hashcap; i++) {
+        if (meta[idx] == STRBASE_INAVLID_STR) {
+            meta[idx] = counter;
+            stridx[idx] = key;
+            break;
+        }
+
+        if ((u32)meta[idx] < counter) {
+            u32 tmpcounter = meta[idx];
+            u32 tmpslot = stridx[idx];
+
+            meta[idx] = counter;
+            stridx[idx] = key;
+
+            counter = tmpcounter;
+            key = tmpslot;
+        }
+
+        idx = (idx + 1) & mask;
+        counter++;
+    }
+
+    __atomic_store_n(&hdr->hashsize, slot + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&hdr->seq, hdr->seq + 1, __ATOMIC_RELEASE);
+    return slot;
+}
+
+StrID StrShmAdd(StrShm *shm, SString s) {
+    if (!shm->writer) {
+        debugerr("StrShmAdd on a read only StrShm");
+        return STRBASE_INAVLID_STR;
+    }
+    return ShmInsert(shm, s, FNVHash32((u8 *)s.data, s.len));
+}
+
+u32 StrShmExport(StrShm *shm, StrBase *base, StrID *remap) {
+    if (remap)
+        memset(remap, -1, base->maxslots * sizeof(StrID));
+    if (!shm->writer)
+        return 0;
+
+    u32 count = 0;
+    for (u32 slot = 0; slot < base->maxslots; slot++) {
+        if (!base->refs[slot])
+            continue;
+
+        StrID id = ShmInsert(shm, base->strstore[slot], base->hashes[slot]);
+        if (id == STRBASE_INAVLID_STR)
+            continue;
+
+        if (remap)
+            remap[slot] = id;
+        count++;
+    }
+    return count;
+}
+
+#endif
+#endif
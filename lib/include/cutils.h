@@ -73,6 +73,45 @@ void StackDestroy(Allocator a, StackAllocator s);
 void *StackAlloc(StackAllocator s, u64 size);
 void StackReset(StackAllocator s);
 
+// counting allocator, forwards to a parent and keeps stats
+
+#define COUNTING_CLASSES 32 // class k holds requests of (2^(k-1), 2^k] bytes
+
+typedef struct CountingAllocator {
+    Allocator parent;
+
+    u64 allocs;
+    u64 reallocs;
+    u64 frees;
+
+    u64 live; // bytes currently allocated
+    u64 peak; // max of live since create/reset
+    u64 total; // bytes requested by allocs and growing reallocs
+
+    u64 classes[COUNTING_CLASSES];
+} *CountingAllocator;
+
+Allocator CountingAllocatorCreate(Allocator parent);
+void CountingAllocatorFree(Allocator c);
+
+// zeroes counters, peak restarts at the current live size
+void CountingAllocatorReset(Allocator c);
+
+/*
+    Virtual Memory
+*/
+
+// reserves address space only, nothing is readable until committed
+void *vmreserve(u64 size);
+void vmrelease(void *ptr, u64 size);
+
+// ptr and size should be PAGE_SIZE aligned
+bool8 vmcommit(void *ptr, u64 size);
+void vmdecommit(void *ptr, u64 size);
+
+// hint that the range should be backed by huge pages
+void vmhugepages(void *ptr, u64 size);
+
 /*
     Sized Strings
 */
@@ -132,10 +171,24 @@ void fileclose(file file);
 u64 fileread(SString dst, file src);
 u64 filewrite(file *dst, SString src);
 void fileflush(file *dst);
+// flushes and waits until the data is on disk
+void filesync(file *dst);
 
 u64 fileload(SString handle, const SString filename);
 u64 filesave(const SString filename, SString handle);
 
+typedef enum filemap_advice {
+    FILEMAP_NORMAL = 0,
+    FILEMAP_SEQUENTIAL = 1 << 0, // aggressive readahead, pages dropped behind
+    FILEMAP_WILLNEED = 1 << 1,   // start reading the whole file now
+    FILEMAP_RANDOM = 1 << 2,     // no readahead
+} filemap_advice;
+
+// Maps a file read only without copying it, the view stays valid
+// until fileunmap. Returns {0} on failure or for an empty file.
+LString filemap(const SString filename, filemap_advice advice);
+void fileunmap(LString map);
+
 void filedelete(SString filename);
 
 void setdir(SString dir);
@@ -150,6 +203,8 @@ Format Table:
 
     %d -> int
 
+    %u -> u64
+
     %n -> null terminated string
 
     %s -> SString (sized string)
@@ -164,6 +219,8 @@ Format Table:
 
     %d -> int
 
+    %u -> u64
+
     %n -> null terminated string
 
     %s -> SString (sized string)
@@ -174,6 +231,9 @@ Format Table:
 // Not threadsafe
 u32 fformat(file *dst, const char *format, ...);
 
+// single line summary of a CountingAllocator
+u32 CountingAllocatorReport(file *dst, Allocator c);
+
 /*
     Custom Logging
 */
@@ -363,6 +423,104 @@ void *StackAlloc(StackAllocator s, u64 size) {
 
 void StackReset(StackAllocator s) { s->size = 0; }
 
+static u32 countingClass(u64 size) {
+    u32 k = 0;
+    while (k < COUNTING_CLASSES - 1 && (1UL << k) < size) k++;
+    return k;
+}
+
+static alloc_func_def(countingAllocator) {
+    CountingAllocator c = ctx;
+
+    if (!new) {
+        // free
+        if (ptr) {
+            c->frees++;
+            c->live -= old;
+        }
+        return c->parent.a(c->parent.ctx, ptr, old, new);
+    }
+
+    void *out = c->parent.a(c->parent.ctx, ptr, old, new);
+    if (!out)
+        return out;
+
+    if (!ptr && !old) {
+        c->allocs++;
+    } else {
+        c->reallocs++;
+    }
+
+    c->classes[countingClass(new)]++;
+    if (new > old)
+        c->total += new - old;
+
+    c->live += new;
+    c->live -= old;
+    if (c->live > c->peak)
+        c->peak = c->live;
+
+    return out;
+}
+
+Allocator CountingAllocatorCreate(Allocator parent) {
+    CountingAllocator c = Alloc(parent, sizeof(struct CountingAllocator));
+    memset(c, 0, sizeof(struct CountingAllocator));
+    c->parent = parent;
+
+    return (Allocator){
+        .a = countingAllocator,
+        .ctx = c,
+    };
+}
+
+void CountingAllocatorFree(Allocator c) {
+    CountingAllocator counter = c.ctx;
+    Free(counter->parent, counter, sizeof(struct CountingAllocator));
+}
+
+void CountingAllocatorReset(Allocator c) {
+    CountingAllocator counter = c.ctx;
+    counter->allocs = 0;
+    counter->reallocs = 0;
+    counter->frees = 0;
+    counter->total = 0;
+    counter->peak = counter->live;
+    memset(counter->classes, 0, sizeof(counter->classes));
+}
+
+/*
+    Virtual Memory Implementations
+    Platform Dependent
+*/
+
+#include <sys/mman.h>
+
+void *vmreserve(u64 size) {
+    void *ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ptr == MAP_FAILED) {
+        debugerr("Failed to reserve %d MB", (i32)(size >> 20));
+        return NULL;
+    }
+    return ptr;
+}
+
+void vmrelease(void *ptr, u64 size) {
+    if (ptr)
+        munmap(ptr, size);
+}
+
+bool8 vmcommit(void *ptr, u64 size) {
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+void vmdecommit(void *ptr, u64 size) {
+    madvise(ptr, size, MADV_DONTNEED);
+    mprotect(ptr, size, PROT_NONE);
+}
+
+void vmhugepages(void *ptr, u64 size) { madvise(ptr, size, MADV_HUGEPAGE); }
+
 /*
     String Implementations
 */
@@ -483,7 +641,6 @@ static u64 flushdata(u64 handle, SString src) {
 }
 
 void fileclose(file file) {
-    printf("buf: %d, acc: %d\n", file.buffered, file.accum);
     if (file.buffered && file.accum) {
         flushdata(file.handle, (SString){.len = file.accum, .data = file.buf});
     }
@@ -499,7 +656,7 @@ u64 fileread(SString dst, file src) {
     u64 accum = 0;
 
     while (accum != size) {
-        i64 bytes = read(src.handle, buffer, size);
+        i64 bytes = read(src.handle, buffer + accum, size - accum);
         if (bytes < 0) {
             // error
             panic();
@@ -546,6 +703,11 @@ void fileflush(file *file) {
     }
 }
 
+void filesync(file *dst) {
+    fileflush(dst);
+    fdatasync(dst->handle);
+}
+
 u64 fileload(SString handle, const SString filename) {
     file f = fileopen(filename, FILE_READ);
     if (f.handle == -1)
@@ -555,6 +717,45 @@ u64 fileload(SString handle, const SString filename) {
     return size;
 }
 
+LString filemap(const SString filename, filemap_advice advice) {
+    int fd = open((char *)filename.data, O_RDONLY);
+
+    struct stat statbuf;
+    if (fd < 0 || fstat(fd, &statbuf)) {
+        debugerr("Failed to Open file: %s %d", filename, fd);
+        if (fd >= 0)
+            close(fd);
+        return (LString){0};
+    }
+
+    if (!statbuf.st_size) {
+        close(fd);
+        return (LString){0};
+    }
+
+    // the mapping keeps the file alive on its own
+    void *data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        debugerr("Failed to map file: %s", filename);
+        return (LString){0};
+    }
+
+    if (advice & FILEMAP_SEQUENTIAL)
+        madvise(data, statbuf.st_size, MADV_SEQUENTIAL);
+    if (advice & FILEMAP_WILLNEED)
+        madvise(data, statbuf.st_size, MADV_WILLNEED);
+    if (advice & FILEMAP_RANDOM)
+        madvise(data, statbuf.st_size, MADV_RANDOM);
+
+    return (LString){.len = statbuf.st_size, .data = data};
+}
+
+void fileunmap(LString map) {
+    if (map.data)
+        munmap(map.data, map.len);
+}
+
 u64 filesave(const SString filename, SString handle) {
     file f = fileopen(filename, FILE_WRITE | FILE_TRUNC | FILE_CREAT);
     if (f.handle == -1)
@@ -768,6 +969,28 @@ static void format_float(formatInfo info, f64 num) {
     info.f((u8)mdig + '0', info.ctx);
 }
 
+static void format_u64(formatInfo info, u64 num) {
+    if (num == 0) {
+        info.f('0', info.ctx);
+        return;
+    }
+
+    // calc number of digits
+    u32 digits = 0;
+    for (u32 i = 0; i < ARRAY_SIZE(power10plus); i++) {
+        if ((num / power10plus[i]) == 0UL)
+            break;
+        digits++;
+    }
+
+    // print digits
+    for (i32 i = digits - 1; i >= 0; i--) {
+        u32 digit = num / power10plus[i];
+        num -= digit * power10plus[i];
+        info.f(digit + '0', info.ctx);
+    }
+}
+
 static ptrdiff_t format_arg(formatInfo info, va_list args, const char *format) {
     ptrdiff_t out = 0;
     switch (format[0]) {
@@ -777,29 +1000,11 @@ static ptrdiff_t format_arg(formatInfo info, va_list args, const char *format) {
             info.f('-', info.ctx);
             s *= -1;
         }
-        u64 num = s;
-
-        if (num == 0) {
-            info.f('0', info.ctx);
-            out++;
-            break;
-        }
-
-        // calc number of digits
-        u32 digits = 0;
-        for (u32 i = 0; i < ARRAY_SIZE(power10plus); i++) {
-            if ((num / power10plus[i]) == 0UL)
-                break;
-            digits++;
-        }
-
-        // print digits
-        for (i32 i = digits - 1; i >= 0; i--) {
-            u32 digit = num / power10plus[i];
-            num -= digit * power10plus[i];
-            info.f(digit + '0', info.ctx);
-        }
-
+        format_u64(info, s);
+        out++;
+    } break;
+    case 'u': {
+        format_u64(info, va_arg(args, u64));
         out++;
     } break;
     case 'f': {
@@ -917,6 +1122,19 @@ file errfile = {
     .closefd = 1,
 };
 
+u32 CountingAllocatorReport(file *dst, Allocator c) {
+    CountingAllocator counter = c.ctx;
+    u32 out = fformat(dst, "allocs %u reallocs %u frees %u live %u peak %u", counter->allocs,
+                      counter->reallocs, counter->frees, counter->live, counter->peak);
+
+    for (u32 i = 0; i < COUNTING_CLASSES; i++) {
+        if (counter->classes[i])
+            out += fformat(dst, " %u:%u", 1UL << i, counter->classes[i]);
+    }
+    out += fformat(dst, "\n");
+    return out;
+}
+
 u32 printlog(const char *format, ...) {
     fileInfo info = {
         .dst = &logfile,
@@ -0,0 +1,23 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <cutils.h>
+#include <stdlib.h>
+
+/*
+    Allocator stats for the runner. The runner hands each test
+    a pipe through STRBASE_REPORT_FD, standalone runs log instead.
+*/
+
+static void report(Allocator a) {
+    char *fd = getenv("STRBASE_REPORT_FD");
+    if (!fd) {
+        CountingAllocatorReport(&logfile, a);
+        return;
+    }
+
+    file dst = {.handle = atoi(fd), .closefd = 1};
+    CountingAllocatorReport(&dst, a);
+}
+
+#endif
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #define CU_IMPL
 #include <cutils.h>
 #include <dirent.h>
@@ -5,9 +6,26 @@
 #include <linux/limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+/*
+    usage: runner [v] [jN]
+
+    v  -> show test output (runs serially unless jN is given)
+    jN -> run up to N tests at once, defaults to the cpu count
+*/
+
+typedef struct job {
+    char name[NAME_MAX + 1];
+    pid_t pid;
+    int report; // read end of the report pipe
+    f64 start;
+} job;
+
 char *sb_stripext(char *f) {
     char *cursor = f;
     while (cursor[0]) cursor++;
@@ -16,8 +34,28 @@ char *sb_stripext(char *f) {
     return f;
 }
 
-void runtest(const char *name, int verbose) {
-    if (fork()) {
+f64 now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// fills in the pid and the read end of the test's report pipe
+void runtest(job *j, int verbose) {
+    char path[PATH_MAX + 1] = {0};
+    snprintf(path, PATH_MAX, "./tests/%s", j->name);
+
+    int report[2];
+    if (pipe2(report, O_CLOEXEC)) {
+        debugerr("Failed to create report pipe");
+        exit(-1);
+    }
+
+    j->start = now();
+    j->pid = fork();
+    if (j->pid) {
+        close(report[1]);
+        j->report = report[0];
         return;
     }
 
@@ -30,50 +68,62 @@ void runtest(const char *name, int verbose) {
 
     setenv("ASAN_OPTIONS", "exitcode=69", 1);
 
-    execlp(name, name, NULL);
+    // write end has to survive the exec
+    int fd = dup(report[1]);
+    char fdname[16] = {0};
+    snprintf(fdname, sizeof(fdname), "%d", fd);
+    setenv("STRBASE_REPORT_FD", fdname, 1);
+
+    execlp(path, path, NULL);
 
     printf("failed to find file\n");
     exit(-1);
 }
 
-u32 printheader(char *name, int verbose) {
-    if (verbose) {
-        printf("================\n");
-        printf("Running Test: %s\n", name);
-        printf("================\n");
-        return 0;
-    }
+// allocator stats the test wrote before exiting
+void printreport(int fd) {
+    char buf[PAGE_SIZE] = {0};
+    u32 size = 0;
+
+    i64 bytes;
+    while ((bytes = read(fd, buf + size, sizeof(buf) - 1 - size)) > 0) size += bytes;
+    close(fd);
 
-    return printf("- %s...", name);
+    if (size)
+        printf("     %s", buf);
 }
 
-void printstatus(u32 shift, int verbose) {
-    int status = 0;
+// returns 1 on failure
+int printstatus(job *j, int status, struct rusage *usage, int verbose) {
+    f64 elapsed = (now() - j->start) * 1000.0;
+    f64 rss = usage->ru_maxrss / 1024.0; // kilobytes on linux
+
     if (verbose) {
-        while (waitpid(0, &status, 0) > 0);
-        return;
+        printf("================\n");
+        printf("Finished Test: %s\n", j->name);
+        printf("================\n");
     }
 
-    printf("%*s", 20 - shift, " ");
-
-    while (waitpid(0, &status, 0) > 0) {
-        if (!WIFEXITED(status) || WIFSIGNALED(status)) {
-            printf("\033[38;2;255;0;0m Failed\033[0m\n");
-            return;
-        }
-
-        if (WEXITSTATUS(status) == 69) {
-            printf("\033[38;2;255;255;0m Leak\033[0m\n");
-            return;
-        }
-
-        if (WEXITSTATUS(status)) {
-            printf("\033[38;2;255;0;0m Failed : %d\033[0m\n", WEXITSTATUS(status));
-            return;
-        }
+    u32 shift = printf("- %s...", j->name);
+    printf("%*s", shift < 20 ? 20 - shift : 1, " ");
+
+    int failed = 1;
+    if (!WIFEXITED(status) || WIFSIGNALED(status)) {
+        printf("\033[38;2;255;0;0m Failed       \033[0m");
+    } else if (WEXITSTATUS(status) == 69) {
+        printf("\033[38;2;255;255;0m Leak         \033[0m");
+    } else if (WEXITSTATUS(status)) {
+        printf("\033[38;2;255;0;0m Failed : %-4d\033[0m", WEXITSTATUS(status));
+    } else {
+        printf("\033[38;2;0;255;0m Passed       \033[0m");
+        failed = 0;
     }
 
-    printf("\033[38;2;0;255;0m Passed\033[0m\n");
+    printf(" %10.1f ms %8.1f MB\n", elapsed, rss);
+    printreport(j->report);
+
+    fflush(stdout);
+    return failed;
 }
 
 int main(int argc, char *argv[]) {
@@ -91,27 +141,81 @@ int main(int argc, char *argv[]) {
         exit(-1);
     }
 
+    int verbose = 0;
+    u32 jobs = 0;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == 'j' || (argv[i][0] == '-' && argv[i][1] == 'j')) {
+            jobs = strtoul(argv[i] + (argv[i][0] == '-' ? 2 : 1), NULL, 10);
+        } else {
+            verbose = 1;
+        }
+    }
+
+    if (!jobs)
+        jobs = verbose ? 1 : sysconf(_SC_NPROCESSORS_ONLN);
+    if (!jobs)
+        jobs = 1;
+
+    // collect tests up front so they can be scheduled
+    job *tests = NULL;
+    u32 count = 0;
+    u32 cap = 0;
+
     struct dirent *dir = NULL;
+    while ((dir = readdir(d))) {
+        if (dir->d_type == DT_DIR)
+            continue;
 
-    int verbose = 0;
-    if (argc > 1) {
-        verbose = 1;
+        if (count == cap) {
+            cap = cap ? cap * 2 : 16;
+            tests = realloc(tests, cap * sizeof(job));
+        }
+        tests[count] = (job){0};
+        strncpy(tests[count].name, dir->d_name, NAME_MAX);
+        count++;
     }
+    closedir(d);
 
     printf("   +=================+\n"
            "   |  String Tests   |\n"
            "   +=================+\n");
+    fflush(stdout);
+
+    f64 start = now();
+    u32 launched = 0;
+    u32 running = 0;
+    u32 failed = 0;
+
+    while (launched < count || running) {
+        while (running < jobs && launched < count) {
+            if (verbose) {
+                printf("================\n");
+                printf("Running Test: %s\n", tests[launched].name);
+                printf("================\n");
+                fflush(stdout);
+            }
+            runtest(&tests[launched++], verbose);
+            running++;
+        }
 
-    do {
-        dir = readdir(d);
-        if (dir && dir->d_type != DT_DIR) {
-            char buf[PATH_MAX + 1] = {0};
+        int status = 0;
+        struct rusage usage = {0};
+        pid_t pid = wait4(-1, &status, 0, &usage);
+        if (pid < 0)
+            break;
+
+        for (u32 i = 0; i < launched; i++) {
+            if (tests[i].pid != pid)
+                continue;
+            failed += printstatus(&tests[i], status, &usage, verbose);
+            running--;
+            break;
+        }
+    }
 
-            u32 shift = printheader(dir->d_name, verbose);
+    printf("\n%d/%d passed in %.1f ms (%d jobs)\n", count - failed, count, (now() - start) * 1000.0,
+           jobs);
 
-            snprintf(buf, PATH_MAX, "./tests/%s", dir->d_name);
-            runtest(buf, verbose);
-            printstatus(shift, verbose);
-        }
-    } while (dir);
+    free(tests);
+    return failed ? 1 : 0;
 }
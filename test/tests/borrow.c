@@ -0,0 +1,76 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 1000
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
+    CountingAllocator c = mem.ctx;
+
+    // caller owned dictionary, outlives the base
+    static char dict[COUNT][16];
+    static SString words[COUNT];
+    for (u32 i = 0; i < COUNT; i++) {
+        u32 len = sformat((SString){.data = (i8 *)dict[i], .len = 16}, "word%d", i);
+        words[i] = (SString){.data = (i8 *)dict[i], .len = len};
+    }
+
+    StrID ids[COUNT] = {0};
+    for (u32 i = 0; i < COUNT; i++) {
+        ids[i] = StrBaseAddBorrowed(data, words[i]);
+        assert(GetStr(data, ids[i]).data == words[i].data);
+    }
+
+    // zero copy, only table growth allocated
+    assert(c->allocs < COUNT / 10);
+
+    // a copied add finds the borrowed entry
+    char buf[16];
+    u32 len = sformat((SString){.data = (i8 *)buf, .len = sizeof(buf)}, "word%d", 5);
+    StrID dup = StrBaseAdd(data, (SString){.data = (i8 *)buf, .len = len});
+    assert(dup == ids[5]);
+    assert(GetStr(data, dup).data == words[5].data);
+
+    // an owned entry stays owned when borrowed again
+    StrID own = StrBaseAdd(data, sstring("owned"));
+    char other[] = "owned";
+    StrID again = StrBaseAddBorrowed(data, (SString){.data = (i8 *)other, .len = 5});
+    assert(again == own);
+    assert(GetStr(data, own).data != (i8 *)other);
+    StrBaseDel(data, own);
+    StrBaseDel(data, own);
+
+    // the final release does not free caller memory
+    u64 frees = c->frees;
+    StrBaseDel(data, dup);
+    for (u32 i = 0; i < COUNT / 2; i++) StrBaseDel(data, ids[i]);
+    assert(c->frees == frees);
+
+    // slots reused by a copied string are freed normally
+    StrID fresh = StrBaseAdd(data, sstring("fresh"));
+    StrBaseDel(data, fresh);
+    assert(c->frees == frees + 1);
+
+    // borrowed bits follow the strings when compacting
+    StrID *remap = Alloc(mem, data->maxslots * sizeof(StrID));
+    u32 max = data->maxslots;
+    StrBaseCompact(data, remap);
+    for (u32 i = COUNT / 2; i < COUNT; i++) {
+        ids[i] = remap[StrIDSlot(ids[i])];
+        assert(GetStr(data, ids[i]).data == words[i].data);
+    }
+    Free(mem, remap, max * sizeof(StrID));
+
+    // StrBaseFree leaves the remaining borrowed strings alone
+    StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
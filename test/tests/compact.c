@@ -0,0 +1,104 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 1000
+
+static SString name(char *buf, u32 i) {
+    u32 len = sformat((SString){.data = (i8 *)buf, .len = 16}, "str%d", i);
+    return (SString){.data = (i8 *)buf, .len = len};
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem, STRBASE_DENSE};
+    char buf[16];
+
+    StrID strs[COUNT] = {0};
+    for (u32 i = 0; i < COUNT; i++) {
+        strs[i] = StrBaseAdd(data, name(buf, i));
+        // dense ids come out in order
+        assert(StrIDSlot(strs[i]) == i);
+    }
+    assert(data->freeslots == NULL);
+
+    for (u32 i = 0; i < COUNT; i++) {
+        if (i % 3)
+            StrBaseDel(data, strs[i]);
+    }
+
+    // holes are refilled lowest first
+    StrID a = StrBaseAdd(data, sstring("a"));
+    StrID b = StrBaseAdd(data, sstring("b"));
+    assert(StrIDSlot(a) == 1);
+    assert(StrIDSlot(b) == 2);
+    StrBaseDel(data, a);
+    StrBaseDel(data, b);
+
+    StrID old[COUNT];
+    memcpy(old, strs, sizeof(old));
+
+    u32 live = data->hashsize;
+    StrID *remap = Alloc(mem, data->maxslots * sizeof(StrID));
+    u32 max = data->maxslots;
+
+    assert(StrBaseCompact(data, remap) == live);
+    assert(data->maxslots == live);
+    assert(data->freesize == 0);
+
+    u32 next = 0;
+    for (u32 i = 0; i < COUNT; i++) {
+        u32 slot = StrIDSlot(strs[i]);
+        if (i % 3) {
+            assert(remap[slot] == STRBASE_INAVLID_STR);
+            continue;
+        }
+
+        // order is kept and old ids are stale unless nothing moved
+        StrID id = remap[slot];
+        assert(StrIDSlot(id) == next++);
+        assert(Sstrcmp(StrBaseGet(data, id), name(buf, i)));
+        assert(StrBaseValid(data, strs[i]) == (id == strs[i]));
+        assert(StrBaseAdd(data, name(buf, i)) == id);
+        strs[i] = id;
+    }
+    Free(mem, remap, max * sizeof(StrID));
+
+    // growing again hands out fresh slots past the packed range
+    StrID c = StrBaseAdd(data, sstring("c"));
+    assert(StrIDSlot(c) == live);
+    StrBaseDel(data, c);
+
+    // and ids into the truncated slots stay stale once they are reused
+    StrID more[COUNT];
+    for (u32 i = 0; i < COUNT; i++) more[i] = StrBaseAdd(data, name(buf, COUNT + i));
+    assert(data->maxslots >= max);
+    for (u32 i = 0; i < COUNT; i++) {
+        bool8 kept = i % 3 == 0 && old[i] == strs[i];
+        assert(StrBaseValid(data, old[i]) == kept);
+    }
+    for (u32 i = 0; i < COUNT; i++) StrBaseDel(data, more[i]);
+
+    // default policy compacts too
+    StrBase *lifo = &(StrBase){mem};
+    for (u32 i = 0; i < 64; i++) strs[i] = StrBaseAdd(lifo, name(buf, i));
+    for (u32 i = 0; i < 64; i += 2) StrBaseDel(lifo, strs[i]);
+
+    assert(StrBaseCompact(lifo, NULL) == 32);
+    for (u32 i = 1; i < 64; i += 2) {
+        StrID id = StrBaseAdd(lifo, name(buf, i));
+        assert(StrIDSlot(id) < 32);
+        assert(lifo->refs[StrIDSlot(id)] == 2);
+    }
+    StrBaseFree(lifo);
+
+    StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
@@ -0,0 +1,126 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#define STRCLIENT_IMPL
+#include <strclient.h>
+
+#include "../report.h"
+
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define COUNT 5000
+
+static SString name(char *buf, u32 i) {
+    u32 len = sformat((SString){.data = (i8 *)buf, .len = 16}, "str%d", i);
+    return (SString){.data = (i8 *)buf, .len = len};
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+
+    char path[64];
+    sformat((SString){.data = (i8 *)path, .len = sizeof(path) - 1}, "/tmp/strbased_test_%d.sock",
+            (i32)getpid());
+    SString spath = {.data = (i8 *)path, .len = strlen(path)};
+
+    // tests run from build/, next to the daemon
+    pid_t pid = fork();
+    if (!pid) {
+        // a failed assert must not leave the daemon holding the report pipe
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        execl("./strbased", "./strbased", path, NULL);
+        _exit(127);
+    }
+
+    for (u32 i = 0; i < 500 && access(path, F_OK); i++) usleep(2000);
+    usleep(10000);
+
+    StrClient a = StrClientConnect(spath, mem);
+    StrClient b = StrClientConnect(spath, mem);
+    assert(a.fd >= 0 && b.fd >= 0);
+
+    // one round trip for the whole batch
+    char buf[16];
+    static StrID ids[COUNT];
+    for (u32 i = 0; i < COUNT; i++) StrClientIntern(&a, name(buf, i), &ids[i]);
+    assert(a.frames == 1);
+    assert(StrClientFlush(&a));
+
+    // a second client sees the same IDs, mixed ops keep their order
+    static StrID again[COUNT];
+    static SString got[COUNT];
+    for (u32 i = 0; i < COUNT; i++) {
+        StrClientLookup(&b, name(buf, i), &again[i]);
+        StrClientGet(&b, ids[i], &got[i]);
+    }
+    StrID missing = 0;
+    StrClientIntern(&b, sstring("dropped"), NULL);
+    StrClientGet(&b, ids[0], NULL);
+    StrClientLookup(&b, sstring("missing"), &missing);
+    assert(StrClientFlush(&b));
+
+    // NULL destinations do not shift later results
+    assert(missing == STRBASE_INAVLID_STR);
+    for (u32 i = 0; i < COUNT; i++) {
+        assert(again[i] == ids[i]);
+        assert(Sstrcmp(got[i], name(buf, i)));
+        Free(mem, got[i].data, got[i].len);
+    }
+
+    // releasing the only reference makes the IDs stale
+    for (u32 i = 0; i < COUNT; i++) StrClientRelease(&a, ids[i]);
+    StrClientLookup(&a, name(buf, 0), &again[0]);
+    StrClientGet(&a, ids[1], &got[1]);
+    assert(StrClientFlush(&a));
+    assert(again[0] == STRBASE_INAVLID_STR);
+    assert(got[1].len == 0);
+
+    // large batches flush on their own
+    static char big[4096];
+    memset(big, 'x', sizeof(big));
+    for (u32 i = 0; i < 700; i++) {
+        big[0] = 'a' + i % 26;
+        big[1] = 'a' + i / 26 % 26;
+        StrClientIntern(&b, (SString){.data = (i8 *)big, .len = sizeof(big)}, &ids[i]);
+    }
+    assert(StrClientFlush(&b));
+    assert(ids[0] != ids[1] && ids[0] == ids[26 * 26]);
+
+    // a GET answer past STRWIRE_MAX_FRAME comes back in pieces
+    u32 size = 8 << 20;
+    u32 gets = STRWIRE_MAX_FRAME / size + 2;
+    SString large = {.len = size, .data = Alloc(mem, size)};
+    memset(large.data, 'y', size);
+    StrID lid;
+    StrClientIntern(&a, large, &lid);
+    assert(StrClientFlush(&a));
+    SString lout[16];
+    for (u32 i = 0; i < gets; i++) StrClientGet(&a, lid, &lout[i]);
+    StrClientLookup(&a, name(buf, 2), &again[2]);
+    assert(StrClientFlush(&a));
+    for (u32 i = 0; i < gets; i++) {
+        assert(Sstrcmp(lout[i], large));
+        Free(mem, lout[i].data, lout[i].len);
+    }
+    assert(again[2] == STRBASE_INAVLID_STR);
+    Free(mem, large.data, size);
+
+    StrClientClose(&a);
+    StrClientClose(&b);
+
+    kill(pid, SIGTERM);
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(access(path, F_OK));
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
@@ -4,8 +4,11 @@
 #define STRBASE_IMPL
 #include <strbase.h>
 
+#include "../report.h"
+
 int main() {
-    StrBase *data = &(StrBase){GlobalAllocator};
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
 
     StrID strs[10] = {0};
     for (u32 i = 0; i < ARRAY_SIZE(strs); i++) {
@@ -50,5 +53,8 @@ int main() {
 
 
     StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
     return 0;
 }
@@ -0,0 +1,130 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#include <unistd.h>
+
+#define COUNT 1000
+
+static SString name(char *buf, u32 i) {
+    u32 len = sformat((SString){.data = (i8 *)buf, .len = 16}, "str%d", i);
+    return (SString){.data = (i8 *)buf, .len = len};
+}
+
+// every slot of a matches b, ids included
+static void same(StrBase *a, StrBase *b) {
+    assert(a->hashsize == b->hashsize);
+    for (u32 i = 0; i < a->maxslots; i++) {
+        if (!BitmapGet(a->occupied, i))
+            continue;
+
+        StrID id = MakeStrID(i, a->gens[i]);
+        assert(StrBaseValid(b, id));
+        assert(Sstrcmp(StrBaseGet(b, id), GetStr(a, id)));
+        assert(StrBaseFind(b, GetStr(a, id)) == id);
+        assert(b->refs[i] == a->refs[i]);
+    }
+}
+
+static u32 dirtycount(StrBase *base) {
+    u32 count = 0;
+    for (u32 i = 0; i < BitmapWords(base->maxslots); i++)
+        count += __builtin_popcountl(base->dirty[i]);
+    return count;
+}
+
+// base image plus the first n deltas
+static StrBase *chain(Allocator mem, SString snap, SString *deltas, u32 n) {
+    StrBase *base = Alloc(mem, sizeof(StrBase));
+    *base = (StrBase){mem};
+    assert(StrBaseLoad(base, snap));
+    for (u32 i = 0; i < n; i++) assert(StrBaseLoadDelta(base, deltas[i]));
+    assert(dirtycount(base) == 0);
+    return base;
+}
+
+static void drop(Allocator mem, StrBase *base) {
+    StrBaseFree(base);
+    Free(mem, base, sizeof(StrBase));
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    SString snap = sstring("delta_test.snap");
+    SString deltas[3] = {sstring("delta_test.1"), sstring("delta_test.2"), sstring("delta_test.3")};
+    char buf[16];
+
+    StrBase *data = &(StrBase){mem};
+    StrID strs[COUNT] = {0};
+    for (u32 i = 0; i < COUNT; i++) strs[i] = StrBaseAdd(data, name(buf, i));
+    assert(dirtycount(data) == COUNT);
+
+    assert(StrBaseSave(data, snap));
+    assert(dirtycount(data) == 0);
+
+    // only the changed slots go into a delta
+    for (u32 i = 0; i < COUNT; i += 10) StrBaseDel(data, strs[i]);
+    StrID added = StrBaseAdd(data, sstring("added"));
+    assert(dirtycount(data) == COUNT / 10);
+
+    assert(StrBaseSaveDelta(data, deltas[0]));
+    LString image = filemap(snap, FILEMAP_NORMAL);
+    LString delta = filemap(deltas[0], FILEMAP_NORMAL);
+    assert(delta.len < image.len / 4);
+    fileunmap(image);
+    fileunmap(delta);
+    assert(dirtycount(data) == 0);
+
+    StrBase *copy = chain(mem, snap, deltas, 1);
+    same(data, copy);
+    assert(StrBaseFind(copy, sstring("added")) == added);
+    drop(mem, copy);
+
+    // the second delta builds on the first
+    StrBaseDel(data, added);
+    for (u32 i = 0; i < COUNT; i += 10) strs[i] = StrBaseAdd(data, name(buf, i));
+    assert(StrBaseSaveDelta(data, deltas[1]));
+
+    copy = chain(mem, snap, deltas, 2);
+    same(data, copy);
+    assert(!StrBaseValid(copy, added));
+    drop(mem, copy);
+
+    // out of order deltas are refused
+    copy = &(StrBase){mem};
+    assert(StrBaseLoad(copy, snap));
+    assert(!StrBaseLoadDelta(copy, deltas[1]));
+    assert(StrBaseLoadDelta(copy, deltas[0]));
+    assert(!StrBaseLoadDelta(copy, deltas[0]));
+    assert(!StrBaseLoadDelta(copy, snap));
+    StrBaseFree(copy);
+
+    // compaction releases slots, the delta drops them as well
+    for (u32 i = 0; i < COUNT; i++) {
+        if (i % 2)
+            StrBaseDel(data, strs[i]);
+    }
+    StrID *remap = Alloc(mem, data->maxslots * sizeof(StrID));
+    u32 max = data->maxslots;
+    StrBaseCompact(data, remap);
+    Free(mem, remap, max * sizeof(StrID));
+    assert(StrBaseSaveDelta(data, deltas[2]));
+
+    copy = chain(mem, snap, deltas, 3);
+    same(data, copy);
+    assert(copy->maxslots == data->maxslots);
+    assert(StrBaseAdd(copy, name(buf, 1)) == StrBaseAdd(data, name(buf, 1)));
+    drop(mem, copy);
+
+    StrBaseFree(data);
+    filedelete(snap);
+    for (u32 i = 0; i < 3; i++) filedelete(deltas[i]);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
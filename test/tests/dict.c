@@ -0,0 +1,98 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 1000
+
+static SString name(char *buf, u32 i) {
+    u32 len = sformat((SString){.data = (i8 *)buf, .len = 16}, "str%d", i);
+    return (SString){.data = (i8 *)buf, .len = len};
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
+    char buf[16];
+
+    StrID strs[COUNT] = {0};
+    for (u32 i = 0; i < COUNT; i++) strs[i] = StrBaseAdd(data, name(buf, i));
+    for (u32 i = 0; i < COUNT; i += 7) StrBaseDel(data, strs[i]);
+
+    u32 n = data->maxslots;
+    u64 size = StrBaseExportDictSize(data);
+    u8 *bytes = Alloc(mem, size);
+    u64 *offsets = Alloc(mem, (n + 1) * sizeof(u64));
+    u64 *validity = Alloc(mem, BitmapWords(n) * sizeof(u64));
+    assert(StrBaseExportDict(data, bytes, offsets, validity) == n);
+    assert(offsets[n] == size);
+
+    // entry i is slot i, free slots are empty nulls
+    for (u32 i = 0; i < COUNT; i++) {
+        u32 slot = StrIDSlot(strs[i]);
+        SString s = {.len = offsets[slot + 1] - offsets[slot], .data = (i8 *)bytes + offsets[slot]};
+        if (i % 7) {
+            assert(BitmapGet(validity, slot));
+            assert(Sstrcmp(s, name(buf, i)));
+        } else {
+            assert(!BitmapGet(validity, slot));
+            assert(s.len == 0);
+        }
+    }
+
+    // a fresh base gets the same slots back
+    StrBase *copy = &(StrBase){mem};
+    StrID *ids = Alloc(mem, n * sizeof(StrID));
+    StrBaseImportDict(copy, bytes, offsets, validity, n, 0, ids);
+    assert(copy->hashsize == data->hashsize);
+    assert(copy->maxslots == n);
+    for (u32 i = 0; i < n; i++) {
+        if (!BitmapGet(validity, i)) {
+            assert(ids[i] == STRBASE_INAVLID_STR);
+            continue;
+        }
+        assert(StrIDSlot(ids[i]) == i);
+        assert(Sstrcmp(StrBaseGet(copy, ids[i]), GetStr(data, MakeStrID(i, data->gens[i]))));
+        assert(!BitmapGet(copy->borrowed, i));
+    }
+
+    // free slots are handed out again
+    u32 before = copy->maxslots;
+    for (u32 i = 0; i < COUNT; i += 7) StrBaseAdd(copy, name(buf, i + COUNT));
+    assert(copy->maxslots == before);
+    StrBaseFree(copy);
+
+    // borrowed, duplicates fold into their first occurrence
+    u8 dup[] = "aabbaa";
+    u64 dupoffsets[] = {0, 2, 4, 6};
+    copy = &(StrBase){mem};
+    StrBaseImportDict(copy, dup, dupoffsets, NULL, 3, 1, ids);
+    assert(ids[0] == ids[2]);
+    assert(copy->hashsize == 2);
+    assert(copy->refs[StrIDSlot(ids[0])] == 2);
+    assert(GetStr(copy, ids[1]).data == (i8 *)dup + 2);
+    assert(BitmapGet(copy->borrowed, 1));
+    assert(StrBaseFind(copy, sstring("bb")) == ids[1]);
+
+    // into a base that is in use, everything goes through the table
+    StrBaseImportDict(copy, bytes, offsets, validity, n, 0, ids);
+    assert(copy->hashsize == data->hashsize + 2);
+    for (u32 i = 0; i < n; i++) {
+        if (BitmapGet(validity, i))
+            assert(Sstrcmp(StrBaseGet(copy, ids[i]), GetStr(data, MakeStrID(i, data->gens[i]))));
+    }
+    StrBaseFree(copy);
+
+    Free(mem, ids, n * sizeof(StrID));
+    Free(mem, bytes, size);
+    Free(mem, offsets, (n + 1) * sizeof(u64));
+    Free(mem, validity, BitmapWords(n) * sizeof(u64));
+    StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
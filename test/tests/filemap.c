@@ -0,0 +1,59 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 20000
+#define FILENAME "filemap.txt"
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
+
+    // a few pages of lines
+    static char text[COUNT * 8];
+    u32 len = 0;
+    for (u32 i = 0; i < COUNT; i++) {
+        len += sformat((SString){.data = (i8 *)&text[len], .len = 8}, "l%d\n", i % 1000);
+    }
+    filesave(sstring(FILENAME), (SString){.data = (i8 *)text, .len = len});
+
+    LString map = filemap(sstring(FILENAME), FILEMAP_SEQUENTIAL | FILEMAP_WILLNEED);
+    assert(map.len == len);
+    assert(memcmp(map.data, text, len) == 0);
+
+    // zero copy interning straight out of the mapping
+    u32 lines = 0;
+    u64 start = 0;
+    for (u64 i = 0; i < map.len; i++) {
+        if (map.data[i] != '\n')
+            continue;
+        StrID id = StrBaseAddBorrowed(data, (SString){.len = i - start, .data = map.data + start});
+        assert(GetStr(data, id).data >= map.data && GetStr(data, id).data < map.data + map.len);
+        start = i + 1;
+        lines++;
+    }
+    assert(lines == COUNT);
+    assert(data->hashsize == 1000);
+
+    StrBaseFree(data);
+    fileunmap(map);
+
+    // the mapping is read only but survives the file going away
+    map = filemap(sstring(FILENAME), FILEMAP_RANDOM);
+    filedelete(sstring(FILENAME));
+    assert(map.data[0] == 'l');
+    fileunmap(map);
+
+    // missing files map to nothing
+    map = filemap(sstring("missing.txt"), FILEMAP_NORMAL);
+    assert(!map.data && !map.len);
+    fileunmap(map);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 2000
+
+static SString name(char *buf, u32 i) {
+    u32 len = sformat((SString){.data = (i8 *)buf, .len = 16}, "s%d", (i * 7919) % 100003);
+    return (SString){.data = (i8 *)buf, .len = len};
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem, STRBASE_PREFIX};
+    char buf[16];
+
+    StrID strs[COUNT] = {0};
+    for (u32 i = 0; i < COUNT; i++) strs[i] = StrBaseAdd(data, name(buf, i));
+    for (u32 i = 0; i < COUNT; i += 5) StrBaseDel(data, strs[i]);
+    StrID empty = StrBaseAdd(data, sstring(""));
+    StrBaseAdd(data, sstring("s1"));
+    StrBaseAdd(data, sstring("s10"));
+
+    StrID old[COUNT];
+    memcpy(old, strs, sizeof(old));
+
+    u32 live = data->hashsize;
+    u32 max = data->maxslots;
+    StrID *remap = Alloc(mem, max * sizeof(StrID));
+    assert(StrBaseFreeze(data, remap) == live);
+    assert(data->maxslots == live);
+    assert(data->flags & STRBASE_FROZEN);
+
+    // slot order is string order
+    for (u32 k = 1; k < live; k++) {
+        SString a = data->strstore[k - 1], b = data->strstore[k];
+        u32 min = a.len < b.len ? a.len : b.len;
+        i32 c = memcmp(a.data, b.data, min);
+        assert(c < 0 || (c == 0 && a.len < b.len));
+    }
+    assert(StrIDSlot(remap[StrIDSlot(empty)]) == 0);
+
+    for (u32 i = 0; i < COUNT; i++) {
+        u32 slot = StrIDSlot(strs[i]);
+        if (i % 5 == 0) {
+            // the slot may have been reused by the extra strings
+            assert(remap[slot] == STRBASE_INAVLID_STR ||
+                   !Sstrcmp(GetStr(data, remap[slot]), name(buf, i)));
+            continue;
+        }
+        assert(Sstrcmp(StrBaseGet(data, remap[slot]), name(buf, i)));
+        strs[i] = remap[slot];
+    }
+    Free(mem, remap, max * sizeof(StrID));
+
+    // existing strings take references, new ones are turned away
+    assert(StrBaseAdd(data, name(buf, 1)) == strs[1]);
+    assert(data->refs[StrIDSlot(strs[1])] == 2);
+    assert(StrBaseAdd(data, sstring("new")) == STRBASE_INAVLID_STR);
+    assert(StrBaseAdd(data, name(buf, 0)) == STRBASE_INAVLID_STR);
+    assert(data->hashsize == live);
+
+    // released strings do not come back, the rest stays in order
+    StrBaseDel(data, strs[1]);
+    StrBaseDel(data, strs[1]);
+    assert(StrBaseAdd(data, name(buf, 1)) == STRBASE_INAVLID_STR);
+
+    StrID out[4];
+    u32 found = StrBasePrefixSearch(data, sstring("s1"), out, 4);
+    for (u32 k = 1; k < found; k++) assert(StrIDSlot(out[k - 1]) < StrIDSlot(out[k]));
+
+    // thawed, strings go in again without reviving ids into the
+    // truncated slots
+    data->flags &= ~STRBASE_FROZEN;
+    assert(StrBaseAdd(data, sstring("new")) != STRBASE_INAVLID_STR);
+    for (u32 i = 0; i < COUNT; i++) StrBaseAdd(data, name(buf, COUNT + i));
+    assert(data->maxslots >= max);
+    for (u32 i = 0; i < COUNT; i += 5) assert(!StrBaseValid(data, old[i]));
+    StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 1000
+
+static SString name(char *buf, u32 i) {
+    u32 len = sformat((SString){.data = (i8 *)buf, .len = 16}, "str%d", i);
+    return (SString){.data = (i8 *)buf, .len = len};
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
+    char buf[16];
+
+    StrID strs[COUNT] = {0};
+    for (u32 i = 0; i < COUNT; i++) strs[i] = StrBaseAdd(data, name(buf, i));
+
+    // shuffled, repeated and stale ids
+    StrID ids[3 * COUNT];
+    for (u32 i = 0; i < 3 * COUNT; i++) ids[i] = strs[(i * 7919) % COUNT];
+    StrBaseDel(data, strs[5]);
+    ids[0] = strs[5];
+    ids[1] = STRBASE_INAVLID_STR;
+    // out of range ids well inside the prefetch window
+    ids[100] = STRBASE_INAVLID_STR;
+    ids[101] = MakeStrID(data->maxslots + 5, 0);
+
+    u64 size = StrBaseGatherSize(data, ids, 3 * COUNT);
+    u8 *out = Alloc(mem, size);
+    u64 *offsets = Alloc(mem, (3 * COUNT + 1) * sizeof(u64));
+    StrBaseGather(data, ids, 3 * COUNT, out, offsets);
+    assert(offsets[3 * COUNT] == size);
+
+    for (u32 i = 0; i < 3 * COUNT; i++) {
+        SString s = {.len = offsets[i + 1] - offsets[i], .data = (i8 *)out + offsets[i]};
+        assert(Sstrcmp(s, StrBaseGet(data, ids[i])));
+    }
+    assert(offsets[1] == 0 && offsets[2] == 0);
+    assert(offsets[100] == offsets[102]);
+
+    StrBaseGather(data, ids, 0, out, offsets);
+    assert(offsets[0] == 0);
+    assert(StrBaseGatherSize(data, ids, 0) == 0);
+
+    Free(mem, out, size);
+    Free(mem, offsets, (3 * COUNT + 1) * sizeof(u64));
+    StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
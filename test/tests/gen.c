@@ -0,0 +1,57 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
+
+    StrID a = StrBaseAdd(data, sstring("alpha"));
+    assert(StrBaseValid(data, a));
+    assert(Sstrcmp(StrBaseGet(data, a), sstring("alpha")));
+
+    StrBaseDel(data, a);
+    assert(!StrBaseValid(data, a));
+    assert(StrBaseGet(data, a).data == NULL);
+
+    // the freed slot is reused right away under a new generation
+    StrID b = StrBaseAdd(data, sstring("beta"));
+    assert(StrIDSlot(b) == StrIDSlot(a));
+    assert(b != a);
+    assert(!StrBaseValid(data, a));
+    assert(StrBaseValid(data, b));
+    assert(Sstrcmp(StrBaseGet(data, b), sstring("beta")));
+
+    // stale releases don't touch the new owner
+    StrBaseDel(data, a);
+    assert(data->refs[StrIDSlot(b)] == 1);
+    assert(Sstrcmp(StrBaseGet(data, b), sstring("beta")));
+
+    // out of range and invalid ids
+    assert(!StrBaseValid(data, StrIDSlot(b) + 1000));
+    assert(!StrBaseValid(data, STRBASE_INAVLID_STR));
+    assert(StrBaseGet(data, STRBASE_INAVLID_STR).data == NULL);
+
+    // generations wrap, one full cycle comes back to the same id
+    StrID first = b;
+    StrBaseDel(data, b);
+    for (u32 i = 0; i < STRBASE_GEN_MASK; i++) {
+        b = StrBaseAdd(data, sstring("beta"));
+        assert(StrIDSlot(b) == StrIDSlot(first));
+        assert(b != first);
+        StrBaseDel(data, b);
+    }
+    b = StrBaseAdd(data, sstring("beta"));
+    assert(b == first);
+
+    StrBaseDel(data, b);
+    StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
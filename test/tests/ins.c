@@ -4,8 +4,11 @@
 #define STRBASE_IMPL
 #include <strbase.h>
 
+#include "../report.h"
+
 int main() {
-    StrBase *data = &(StrBase){GlobalAllocator};
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
 
     StrID s = StrBaseAdd(data, sstring("test"));
     StrID s1 = StrBaseAdd(data, sstring("test"));
@@ -33,5 +36,8 @@ int main() {
 
 
     StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
     return 0;
 }
@@ -0,0 +1,62 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 1000
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
+
+    // empty base
+    StrBaseIter it = {0};
+    assert(StrBaseIterNext(data, &it) == STRBASE_INAVLID_STR);
+
+    StrID strs[COUNT] = {0};
+    for (u32 i = 0; i < COUNT; i++) {
+        char buf[16];
+        u32 len = sformat((SString){.data = (i8 *)buf, .len = sizeof(buf)}, "str%d", i);
+        strs[i] = StrBaseAdd(data, (SString){.data = (i8 *)buf, .len = len});
+    }
+
+    // leave sparse runs with long free gaps in between
+    for (u32 i = 0; i < COUNT; i++) {
+        if (i % 97 > 2)
+            StrBaseDel(data, strs[i]);
+    }
+
+    u32 seen = 0;
+    u32 last = 0;
+    it = (StrBaseIter){0};
+    for (StrID id; (id = StrBaseIterNext(data, &it)) != STRBASE_INAVLID_STR;) {
+        assert(StrBaseValid(data, id));
+        assert(!seen || StrIDSlot(id) > last);
+        last = StrIDSlot(id);
+        seen++;
+    }
+    assert(seen == data->hashsize);
+
+    u32 expected = 0;
+    for (u32 i = 0; i < COUNT; i++) expected += i % 97 <= 2;
+    assert(seen == expected);
+
+    // releasing while iterating
+    it = (StrBaseIter){0};
+    for (StrID id; (id = StrBaseIterNext(data, &it)) != STRBASE_INAVLID_STR;) {
+        StrBaseDel(data, id);
+    }
+    assert(data->hashsize == 0);
+
+    it = (StrBaseIter){0};
+    assert(StrBaseIterNext(data, &it) == STRBASE_INAVLID_STR);
+
+    StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
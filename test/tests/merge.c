@@ -0,0 +1,84 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 500
+
+static SString name(char *buf, u32 i) {
+    u32 len = sformat((SString){.data = (i8 *)buf, .len = 16}, "str%d", i);
+    return (SString){.data = (i8 *)buf, .len = len};
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *dst = &(StrBase){mem};
+    StrBase *src = &(StrBase){mem};
+    char buf[16];
+
+    // dst holds [0, COUNT), src holds [COUNT / 2, 2 * COUNT) twice
+    StrID d[COUNT] = {0};
+    for (u32 i = 0; i < COUNT; i++) d[i] = StrBaseAdd(dst, name(buf, i));
+
+    StrID s[2 * COUNT] = {0};
+    for (u32 i = COUNT / 2; i < 2 * COUNT; i++) {
+        s[i] = StrBaseAdd(src, name(buf, i));
+        StrBaseAdd(src, name(buf, i));
+    }
+
+    // a freed slot in src maps to nothing
+    StrID gone = StrBaseAdd(src, sstring("gone"));
+    StrBaseDel(src, gone);
+
+    StrID *remap = Alloc(mem, src->maxslots * sizeof(StrID));
+    u32 srcsize = src->hashsize;
+    StrBaseMerge(dst, src, remap);
+
+    assert(dst->hashsize == 2 * COUNT);
+    assert(remap[StrIDSlot(gone)] == STRBASE_INAVLID_STR);
+
+    for (u32 i = COUNT / 2; i < 2 * COUNT; i++) {
+        StrID id = remap[StrIDSlot(s[i])];
+        assert(Sstrcmp(StrBaseGet(dst, id), name(buf, i)));
+
+        // duplicates keep their dst ID and add up
+        if (i < COUNT) {
+            assert(id == d[i]);
+            assert(dst->refs[StrIDSlot(id)] == 3);
+        } else {
+            assert(dst->refs[StrIDSlot(id)] == 2);
+        }
+        assert(StrBaseAdd(dst, name(buf, i)) == id);
+    }
+
+    // src is untouched
+    assert(src->hashsize == srcsize);
+    for (u32 i = COUNT / 2; i < 2 * COUNT; i++) {
+        assert(Sstrcmp(StrBaseGet(src, s[i]), name(buf, i)));
+        assert(src->refs[StrIDSlot(s[i])] == 2);
+    }
+    Free(mem, remap, src->maxslots * sizeof(StrID));
+    StrBaseFree(src);
+
+    // merged entries delete cleanly through the cached hashes
+    for (u32 i = 0; i < 2 * COUNT; i++) {
+        StrID id = StrBaseAdd(dst, name(buf, i));
+        while (StrBaseValid(dst, id)) StrBaseDel(dst, id);
+    }
+    assert(dst->hashsize == 0);
+
+    // merging into an empty base
+    StrBase *empty = &(StrBase){mem};
+    StrBaseMerge(empty, dst, NULL);
+    assert(empty->hashsize == 0);
+    StrBaseFree(empty);
+
+    StrBaseFree(dst);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
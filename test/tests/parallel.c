@@ -0,0 +1,85 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 50000
+#define UNIQUE 7919
+
+// checks a parallel build against plain StrBaseAdd
+static void check(Allocator mem, u32 flags, u32 nthreads) {
+    static char bufs[COUNT][16];
+    static SString tokens[COUNT];
+    static StrID ids[COUNT];
+
+    for (u32 i = 0; i < COUNT; i++) {
+        // skewed so some strings are very hot
+        u32 v = (i * 2654435761u) % UNIQUE;
+        if (i % 4 == 0)
+            v %= 16;
+        u32 len = sformat((SString){.data = (i8 *)bufs[i], .len = 16}, "tok%d", v);
+        // the empty string last, its bytes sit at the very end
+        if (i == COUNT - 1)
+            len = 0;
+        tokens[i] = (SString){.data = (i8 *)bufs[i], .len = len};
+    }
+
+    StrBase *par = &(StrBase){mem, flags};
+    StrBase *seq = &(StrBase){mem, flags};
+
+    CountingAllocator c = mem.a == GlobalAllocator.a ? NULL : mem.ctx;
+    u64 allocs = c ? c->allocs : 0;
+    StrBaseBuildParallel(par, tokens, COUNT, nthreads, ids);
+    // all strings share one block, whatever the allocator
+    if (c && nthreads > 1)
+        assert(c->allocs - allocs < 64);
+    for (u32 i = 0; i < COUNT; i++) StrBaseAdd(seq, tokens[i]);
+
+    assert(par->hashsize == seq->hashsize);
+    // a parallel build allocates exactly the slots it needs
+    if (nthreads > 1)
+        assert(par->maxslots == par->hashsize);
+
+    for (u32 i = 0; i < COUNT; i++) {
+        assert(StrBaseValid(par, ids[i]));
+        assert(Sstrcmp(StrBaseGet(par, ids[i]), tokens[i]));
+
+        // the table finds every string again
+        StrID s = StrBaseAdd(seq, tokens[i]);
+        assert(par->refs[StrIDSlot(ids[i])] == seq->refs[StrIDSlot(s)] - 1);
+        StrBaseDel(seq, s);
+        assert(StrBaseAdd(par, tokens[i]) == ids[i]);
+        StrBaseDel(par, ids[i]);
+    }
+
+    // growing on top of a parallel build
+    StrID extra = StrBaseAdd(par, sstring("extra"));
+    assert(Sstrcmp(StrBaseGet(par, extra), sstring("extra")));
+    StrBaseDel(par, extra);
+
+    // releasing everything empties the table
+    for (u32 i = 0; i < COUNT; i++) StrBaseDel(par, ids[i]);
+    assert(par->hashsize == 0);
+    assert(par->block == NULL);
+    for (u32 i = 0; i < par->hashcap; i++) assert(par->meta[i] == STRBASE_INAVLID_STR);
+
+    StrBaseFree(par);
+    StrBaseFree(seq);
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+
+    check(mem, 0, 4);
+    check(mem, STRBASE_DENSE, 3);
+    check(mem, 0, 1);
+
+    check(GlobalAllocator, 0, 8);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
@@ -0,0 +1,104 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 5000
+
+static SString name(char *buf, u32 i) {
+    u32 len = sformat((SString){.data = (i8 *)buf, .len = 16}, "str%d", i);
+    return (SString){.data = (i8 *)buf, .len = len};
+}
+
+// matches the index against a scan of every slot
+static void check(StrBase *base, SString prefix, StrID *out) {
+    u32 found = StrBasePrefixSearch(base, prefix, out, COUNT);
+
+    u32 expect = 0;
+    StrBaseIter it = {0};
+    for (StrID id; (id = StrBaseIterNext(base, &it)) != STRBASE_INAVLID_STR;) {
+        SString s = GetStr(base, id);
+        if (s.len >= prefix.len && memcmp(s.data, prefix.data, prefix.len) == 0)
+            expect++;
+    }
+    assert(found == expect);
+
+    for (u32 i = 0; i < found; i++) {
+        SString s = StrBaseGet(base, out[i]);
+        assert(s.len >= prefix.len && memcmp(s.data, prefix.data, prefix.len) == 0);
+        if (i) {
+            // ascending, shorter first on ties
+            SString prev = GetStr(base, out[i - 1]);
+            u32 min = prev.len < s.len ? prev.len : s.len;
+            i32 c = memcmp(prev.data, s.data, min);
+            assert(c < 0 || (c == 0 && prev.len < s.len));
+        }
+    }
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem, STRBASE_PREFIX};
+    StrID *out = Alloc(mem, COUNT * sizeof(StrID));
+    char buf[16];
+
+    StrID strs[COUNT] = {0};
+    for (u32 i = 0; i < COUNT / 2; i++) strs[i] = StrBaseAdd(data, name(buf, i));
+
+    // the first search builds the index
+    assert(data->prefix == NULL);
+    check(data, sstring("str1"), out);
+    assert(data->prefix != NULL);
+
+    // later adds split blocks, releases empty them
+    for (u32 i = COUNT / 2; i < COUNT; i++) strs[i] = StrBaseAdd(data, name(buf, i));
+    check(data, sstring("str1"), out);
+    check(data, sstring("str42"), out);
+    check(data, sstring(""), out);
+
+    assert(StrBasePrefixSearch(data, sstring("str4"), out, 3) == 3);
+    assert(Sstrcmp(StrBaseGet(data, out[0]), sstring("str4")));
+    assert(Sstrcmp(StrBaseGet(data, out[1]), sstring("str40")));
+    assert(Sstrcmp(StrBaseGet(data, out[2]), sstring("str400")));
+
+    for (u32 i = 0; i < COUNT; i++) {
+        if (i % 5)
+            StrBaseDel(data, strs[i]);
+    }
+    check(data, sstring("str1"), out);
+    check(data, sstring("str"), out);
+    assert(StrBasePrefixSearch(data, sstring("zzz"), out, COUNT) == 0);
+    assert(StrBasePrefixSearch(data, sstring("str99999"), out, COUNT) == 0);
+
+    // references on an indexed string keep it indexed
+    StrBaseAdd(data, sstring("str5"));
+    StrBaseDel(data, strs[5]);
+    assert(StrBasePrefixSearch(data, sstring("str5"), out, 1) == 1);
+
+    // renumbering drops the index, the next search rebuilds it
+    StrBaseCompact(data, NULL);
+    assert(data->prefix == NULL);
+    check(data, sstring("str2"), out);
+
+    for (u32 i = 0; i < COUNT; i++) StrBaseDel(data, StrBaseFind(data, name(buf, i)));
+    StrBaseDel(data, StrBaseFind(data, sstring("str5")));
+    assert(data->hashsize == 0);
+    check(data, sstring("str"), out);
+    StrBaseAdd(data, sstring("again"));
+    check(data, sstring("a"), out);
+    StrBaseFree(data);
+
+    // without the flag there is no index
+    StrBase *plain = &(StrBase){mem};
+    StrBaseAdd(plain, sstring("x"));
+    assert(StrBasePrefixSearch(plain, sstring("x"), out, 1) == 0);
+    StrBaseFree(plain);
+
+    Free(mem, out, COUNT * sizeof(StrID));
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
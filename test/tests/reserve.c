@@ -0,0 +1,110 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 1000
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
+
+    StrBaseReserve(data, COUNT);
+    u32 slots = data->maxslots;
+    u32 cap = data->hashcap;
+    assert(slots >= COUNT);
+    assert(COUNT < cap * STRBASE_LOAD_MAX);
+
+    CountingAllocator c = mem.ctx;
+    u64 reallocs = c->reallocs;
+
+    StrID strs[COUNT] = {0};
+    for (u32 i = 0; i < COUNT; i++) {
+        char buf[16];
+        u32 len = sformat((SString){.data = (i8 *)buf, .len = sizeof(buf)}, "str%d", i);
+        strs[i] = StrBaseAdd(data, (SString){.data = (i8 *)buf, .len = len});
+    }
+
+    // nothing grew
+    assert(data->maxslots == slots);
+    assert(data->hashcap == cap);
+    assert(c->reallocs == reallocs);
+
+    // keep a few strings spread over the slot range
+    for (u32 i = 0; i < COUNT; i++) {
+        if (i % 100 == 7)
+            continue;
+        StrBaseDel(data, strs[i]);
+    }
+    assert(data->hashsize == COUNT / 100);
+
+    u64 live = c->live;
+    StrBaseShrink(data);
+    assert(c->live < live);
+    assert(data->hashcap < cap);
+
+    u32 top = 0;
+    for (u32 i = 7; i < COUNT; i += 100) {
+        char buf[16];
+        u32 len = sformat((SString){.data = (i8 *)buf, .len = sizeof(buf)}, "str%d", i);
+        SString s = {.data = (i8 *)buf, .len = len};
+
+        // IDs survive the shrink
+        assert(Sstrcmp(GetStr(data, strs[i]), s));
+        assert(StrBaseAdd(data, s) == strs[i]);
+        assert(data->refs[StrIDSlot(strs[i])] == 2);
+
+        if (StrIDSlot(strs[i]) > top)
+            top = StrIDSlot(strs[i]);
+    }
+    assert(data->maxslots == top + 1);
+
+    printlog("Internal Table State:\n");
+    for (u32 i = 0; i < data->hashcap; i++) {
+        if (data->meta[i] == -1)
+            printlog("\tempty\n");
+        else
+            printlog("\t(%s,%d)\t%d\n", GetStr(data, data->stridx[i]), data->meta[i],
+                     data->refs[data->stridx[i]]);
+    }
+
+    // table is usable after shrinking, released slots do not
+    // bring back the IDs that used them
+    StrID s = StrBaseAdd(data, sstring("fresh"));
+    assert(Sstrcmp(GetStr(data, s), sstring("fresh")));
+    StrID grow[COUNT];
+    for (u32 i = 0; i < COUNT; i++) {
+        char buf[16];
+        u32 len = sformat((SString){.data = (i8 *)buf, .len = sizeof(buf)}, "grow%d", i);
+        grow[i] = StrBaseAdd(data, (SString){.data = (i8 *)buf, .len = len});
+    }
+    for (u32 i = 0; i < COUNT; i++) {
+        if (i % 100 != 7)
+            assert(!StrBaseValid(data, strs[i]));
+    }
+
+    for (u32 i = 7; i < COUNT; i += 100) {
+        StrBaseDel(data, strs[i]);
+        StrBaseDel(data, strs[i]);
+    }
+    StrBaseDel(data, s);
+    for (u32 i = 0; i < COUNT; i++) StrBaseDel(data, grow[i]);
+
+    // empty base shrinks to its generations
+    StrBaseShrink(data);
+    assert(data->maxslots == 0);
+    assert(data->hashcap == 0);
+    assert(c->live == data->gencap);
+
+    s = StrBaseAdd(data, sstring("again"));
+    assert(Sstrcmp(GetStr(data, s), sstring("again")));
+
+    StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
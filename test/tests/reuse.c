@@ -4,8 +4,11 @@
 #define STRBASE_IMPL
 #include <strbase.h>
 
+#include "../report.h"
+
 int main() {
-    StrBase *data = &(StrBase){GlobalAllocator};
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
 
     StrID strs[10] = {0};
 
@@ -34,9 +37,9 @@ int main() {
             sformat((SString){.data = (i8 *)buf, .len = ARRAY_SIZE(buf)}, "test%d", i);
             StrBaseDel(data, strs[i]);
             StrBaseDel(data, strs[i]);
-            assert(data->refs[strs[i]] == 0);
-            assert(data->strstore[strs[i]].data == NULL);
-            assert(data->strstore[strs[i]].len == 0);
+            assert(data->refs[StrIDSlot(strs[i])] == 0);
+            assert(data->strstore[StrIDSlot(strs[i])].data == NULL);
+            assert(data->strstore[StrIDSlot(strs[i])].len == 0);
         }
 
         printlog("string status:\n");
@@ -53,5 +56,8 @@ int main() {
     }
 
     StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
     return 0;
 }
@@ -0,0 +1,116 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#define STRSHM_IMPL
+#include <strshm.h>
+
+#include "../report.h"
+
+#include <sys/wait.h>
+
+#define COUNT 2000
+
+static SString name(char *buf, u32 i) {
+    u32 len = sformat((SString){.data = (i8 *)buf, .len = 16}, "str%d", i);
+    return (SString){.data = (i8 *)buf, .len = len};
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
+    char buf[16];
+
+    StrID ids[COUNT] = {0};
+    for (u32 i = 0; i < COUNT / 2; i++) ids[i] = StrBaseAdd(data, name(buf, i));
+    StrBaseDel(data, ids[3]);
+
+    StrShm shm = StrShmCreate((SString){0}, COUNT, COUNT * 16);
+    assert(shm.hdr);
+
+    StrID *remap = Alloc(mem, data->maxslots * sizeof(StrID));
+    assert(StrShmExport(&shm, data, remap) == COUNT / 2 - 1);
+    assert(remap[StrIDSlot(ids[3])] == STRBASE_INAVLID_STR);
+    for (u32 i = 0; i < COUNT / 2; i++) {
+        if (i == 3)
+            continue;
+        StrID id = remap[StrIDSlot(ids[i])];
+        assert(Sstrcmp(StrShmGet(&shm, id), name(buf, i)));
+        assert(StrShmFind(&shm, name(buf, i)) == id);
+    }
+    Free(mem, remap, data->maxslots * sizeof(StrID));
+
+    // a reader process looks strings up while the writer adds more
+    pid_t pid = fork();
+    if (!pid) {
+        StrShm r = StrShmOpenFd(dup(shm.fd));
+        if (!r.hdr || r.writer)
+            _exit(1);
+
+        for (u32 round = 0; round < 50; round++) {
+            for (u32 i = 0; i < COUNT; i++) {
+                StrID id = StrShmFind(&r, name(buf, i));
+                if (i < COUNT / 2 && i != 3 && id == STRBASE_INAVLID_STR)
+                    _exit(2);
+                if (id != STRBASE_INAVLID_STR && !Sstrcmp(StrShmGet(&r, id), name(buf, i)))
+                    _exit(3);
+            }
+        }
+
+        // read only mappings reject writes
+        if (StrShmAdd(&r, sstring("nope")) != STRBASE_INAVLID_STR)
+            _exit(4);
+
+        StrShmClose(&r);
+        _exit(0);
+    }
+
+    for (u32 i = COUNT / 2; i < COUNT; i++) {
+        StrID id = StrShmAdd(&shm, name(buf, i));
+        assert(id != STRBASE_INAVLID_STR);
+        assert(StrShmAdd(&shm, name(buf, i)) == id);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // str3 was never exported, it takes the last slot
+    assert(StrShmAdd(&shm, sstring("last")) == COUNT - 1);
+    assert(StrShmAdd(&shm, sstring("one too many")) == STRBASE_INAVLID_STR);
+    StrShmClose(&shm);
+
+    // named regions outlive the creator until unlinked
+    char region[32];
+    sformat((SString){.data = (i8 *)region, .len = sizeof(region) - 1}, "/strshm_test_%d",
+            (i32)getpid());
+    SString rname = {.data = (i8 *)region, .len = strlen(region)};
+
+    shm = StrShmCreate(rname, 16, 256);
+    StrID hello = StrShmAdd(&shm, sstring("hello"));
+    StrShmClose(&shm);
+
+    StrShm r = StrShmOpen(rname);
+    assert(r.hdr);
+    assert(StrShmFind(&r, sstring("hello")) == hello);
+    assert(StrShmFind(&r, sstring("world")) == STRBASE_INAVLID_STR);
+    assert(StrShmGet(&r, 5).len == 0);
+
+    // recreating the name leaves open mappings alone
+    shm = StrShmCreate(rname, 4, 64);
+    assert(shm.hdr);
+    assert(StrShmFind(&r, sstring("hello")) == hello);
+    assert(StrShmFind(&shm, sstring("hello")) == STRBASE_INAVLID_STR);
+    StrShmClose(&shm);
+
+    StrShmClose(&r);
+    StrShmUnlink(rname);
+
+    StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
@@ -0,0 +1,80 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 3000
+
+static u64 rng(u64 *state) {
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+// short strings, long shared prefixes and embedded zeros
+static SString make(char *buf, u64 *state) {
+    u32 len = rng(state) % 20;
+    u32 shared = rng(state) % 3 ? 0 : 12;
+    for (u32 i = 0; i < len + shared; i++) {
+        if (i < shared)
+            buf[i] = "sharedprefix"[i];
+        else
+            buf[i] = "ab\0c"[rng(state) % 4];
+    }
+    return (SString){.len = len + shared, .data = (i8 *)buf};
+}
+
+static i32 order(SString a, SString b) {
+    u32 min = a.len < b.len ? a.len : b.len;
+    i32 c = memcmp(a.data, b.data, min);
+    if (c)
+        return c < 0 ? -1 : 1;
+    return (a.len > b.len) - (a.len < b.len);
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
+    char buf[32];
+    u64 state = 0x9e3779b97f4a7c15UL;
+
+    StrID ids[COUNT];
+    for (u32 i = 0; i < COUNT; i++) ids[i] = StrBaseAdd(data, make(buf, &state));
+
+    // compare agrees with the strings
+    for (u32 i = 0; i + 1 < COUNT; i++) {
+        i32 c = StrBaseCompare(data, ids[i], ids[i + 1]);
+        i32 expect = order(GetStr(data, ids[i]), GetStr(data, ids[i + 1]));
+        assert((c > 0) - (c < 0) == expect);
+    }
+    assert(StrBaseCompare(data, ids[0], ids[0]) == 0);
+
+    // duplicates included, the input has repeated strings
+    StrBaseSortIDs(data, ids, COUNT);
+    for (u32 i = 0; i + 1 < COUNT; i++) {
+        assert(order(GetStr(data, ids[i]), GetStr(data, ids[i + 1])) <= 0);
+        assert(StrBaseCompare(data, ids[i], ids[i + 1]) <= 0);
+    }
+
+    // keys move with the strings
+    StrBaseCompact(data, NULL);
+    u32 n = 0;
+    StrBaseIter it = {0};
+    for (StrID id; (id = StrBaseIterNext(data, &it)) != STRBASE_INAVLID_STR;) ids[n++] = id;
+    StrBaseSortIDs(data, ids, n);
+    for (u32 i = 0; i + 1 < n; i++)
+        assert(order(GetStr(data, ids[i]), GetStr(data, ids[i + 1])) < 0);
+
+    StrBaseSortIDs(data, ids, 1);
+    StrBaseSortIDs(data, ids, 0);
+    StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
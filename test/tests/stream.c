@@ -0,0 +1,119 @@
+#define CU_IMPL
+#include <cutils.h>
+
+// small chunks so tokens straddle reads and long ones grow the buffer
+#define STRBASE_STREAM_CHUNK 64
+#define STRBASE_STREAM_BATCH 7
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define COUNT 2000
+#define FILENAME "stream.txt"
+
+typedef struct Collect {
+    StrID ids[COUNT];
+    u32 size;
+    u32 calls;
+} Collect;
+
+typedef struct Trickle {
+    int fd;
+    SString data;
+} Trickle;
+
+// writes data to a pipe in small pieces, so every read comes up short
+static void *trickle(void *arg) {
+    Trickle *t = arg;
+    for (u64 off = 0; off < t->data.len; off += 100) {
+        u64 n = t->data.len - off < 100 ? t->data.len - off : 100;
+        assert(write(t->fd, t->data.data + off, n) == n);
+        usleep(50);
+    }
+    close(t->fd);
+    return NULL;
+}
+
+static void collect(void *ctx, StrID *ids, u32 n) {
+    Collect *c = ctx;
+    assert(n <= STRBASE_STREAM_BATCH);
+    for (u32 i = 0; i < n; i++) c->ids[c->size++] = ids[i];
+    c->calls++;
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem};
+
+    static char text[COUNT * 160];
+    static SString expected[COUNT];
+    u32 len = 0;
+
+    for (u32 i = 0; i < COUNT; i++) {
+        char *tok = &text[len];
+        len += sformat((SString){.data = (i8 *)tok, .len = 16}, "w%d", i % 300);
+
+        // every so often a token longer than the chunk
+        if (i % 97 == 0) {
+            for (u32 k = 0; k < 100 + i % 50; k++) text[len++] = 'a' + k % 26;
+        }
+        expected[i] = (SString){.data = (i8 *)tok, .len = &text[len] - tok};
+
+        // mixed and repeated delimiters, no trailing one at the end
+        if (i + 1 < COUNT) {
+            text[len++] = " \n\t,"[i % 4];
+            if (i % 5 == 0)
+                text[len++] = ' ';
+        }
+    }
+    filesave(sstring(FILENAME), (SString){.data = (i8 *)text, .len = len});
+
+    static Collect c = {0};
+    u64 total = StrBaseInternFile(data, sstring(FILENAME), " \n\t,", collect, &c);
+    assert(total == COUNT);
+    assert(c.size == COUNT);
+    // batches are cut short at every chunk boundary
+    assert(c.calls >= (COUNT + STRBASE_STREAM_BATCH - 1) / STRBASE_STREAM_BATCH);
+
+    for (u32 i = 0; i < COUNT; i++) {
+        assert(Sstrcmp(StrBaseGet(data, c.ids[i]), expected[i]));
+    }
+
+    // refcounts match the number of occurrences
+    for (u32 i = 0; i < COUNT; i++) StrBaseDel(data, c.ids[i]);
+    assert(data->hashsize == 0);
+
+    // too many delimiters for the simd path, only the numbers are left
+    total = StrBaseInternFile(data, sstring(FILENAME), " \n\t,abcdefghijklmnopqrstuvwxyz", NULL,
+                              NULL);
+    assert(total == COUNT);
+    assert(data->hashsize == 300);
+
+    // fileread fills the whole buffer across short reads
+    int fds[2];
+    assert(pipe(fds) == 0);
+    Trickle t = {.fd = fds[1], .data = {.data = (i8 *)text, .len = len}};
+    pthread_t writer;
+    assert(pthread_create(&writer, NULL, trickle, &t) == 0);
+
+    SString whole = {.data = Alloc(mem, len), .len = len};
+    assert(fileread(whole, (file){.handle = fds[0]}) == len);
+    assert(Sstrcmp(whole, t.data));
+    Free(mem, whole.data, len);
+    pthread_join(writer, NULL);
+    close(fds[0]);
+
+    assert(StrBaseInternFile(data, sstring("missing.txt"), " ", NULL, NULL) == 0);
+
+    filedelete(sstring(FILENAME));
+    StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 5000
+
+static SString name(char *buf, u32 i) {
+    u32 len = sformat((SString){.data = (i8 *)buf, .len = 16}, "str%d", i);
+    return (SString){.data = (i8 *)buf, .len = len};
+}
+
+static bool8 contains(SString s, SString sub) {
+    for (u32 i = 0; i + sub.len <= s.len; i++) {
+        if (memcmp(s.data + i, sub.data, sub.len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// matches the index against a scan of every slot
+static void check(StrBase *base, SString sub, StrID *out) {
+    u32 found = StrBaseSubstringSearch(base, sub, out, COUNT);
+
+    u32 expect = 0;
+    StrBaseIter it = {0};
+    for (StrID id; (id = StrBaseIterNext(base, &it)) != STRBASE_INAVLID_STR;) {
+        if (contains(GetStr(base, id), sub))
+            assert(out[expect++] == id);
+    }
+    assert(found == expect);
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem, STRBASE_TRIGRAM};
+    StrID *out = Alloc(mem, COUNT * sizeof(StrID));
+    char buf[16];
+
+    StrID strs[COUNT] = {0};
+    for (u32 i = 0; i < COUNT / 2; i++) strs[i] = StrBaseAdd(data, name(buf, i));
+
+    // the first search builds the index
+    assert(data->trigram == NULL);
+    check(data, sstring("123"), out);
+    assert(data->trigram != NULL);
+
+    for (u32 i = COUNT / 2; i < COUNT; i++) strs[i] = StrBaseAdd(data, name(buf, i));
+    check(data, sstring("123"), out);
+    check(data, sstring("r49"), out);
+    check(data, sstring("4999"), out);
+    check(data, sstring("str"), out);
+    check(data, sstring("99"), out);
+    check(data, sstring(""), out);
+    assert(StrBaseSubstringSearch(data, sstring("xyz"), out, COUNT) == 0);
+    assert(StrBaseSubstringSearch(data, sstring("str1"), out, 4) == 4);
+
+    // freed strings drop out, reused slots are found once
+    for (u32 i = 0; i < COUNT; i++) {
+        if (i % 4)
+            StrBaseDel(data, strs[i]);
+    }
+    check(data, sstring("123"), out);
+    for (u32 i = 1; i < COUNT; i += 4) strs[i] = StrBaseAdd(data, name(buf, i + 100000));
+    check(data, sstring("100"), out);
+    check(data, sstring("str1"), out);
+
+    // enough releases throw the index away for a rebuild
+    for (u32 i = 10; i < COUNT; i++) StrBaseDel(data, strs[i]);
+    assert(data->trigram == NULL);
+    check(data, sstring("str1"), out);
+    assert(data->trigram != NULL);
+
+    // repeated trigrams inside a string
+    StrID aaa = StrBaseAdd(data, sstring("aaaaaaa"));
+    assert(StrBaseSubstringSearch(data, sstring("aaaa"), out, COUNT) == 1);
+    assert(out[0] == aaa);
+
+    StrBaseShrink(data);
+    check(data, sstring("str"), out);
+    StrBaseFree(data);
+
+    Free(mem, out, COUNT * sizeof(StrID));
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#define COUNT 100000
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    StrBase *data = &(StrBase){mem, STRBASE_VMEM | STRBASE_HUGEPAGES};
+
+    StrID first = StrBaseAdd(data, sstring("first"));
+    SString *store = data->strstore;
+    SString *pinned = &GetStr(data, first);
+
+    static StrID strs[COUNT] = {0};
+    for (u32 i = 0; i < COUNT; i++) {
+        char buf[16];
+        u32 len = sformat((SString){.data = (i8 *)buf, .len = sizeof(buf)}, "str%d", i);
+        strs[i] = StrBaseAdd(data, (SString){.data = (i8 *)buf, .len = len});
+    }
+
+    // growth never moved the slot arrays
+    assert(data->strstore == store);
+    assert(data->maxslots > COUNT);
+    assert(Sstrcmp(*pinned, sstring("first")));
+
+    for (u32 i = 0; i < COUNT; i++) {
+        char buf[16];
+        u32 len = sformat((SString){.data = (i8 *)buf, .len = sizeof(buf)}, "str%d", i);
+        assert(Sstrcmp(GetStr(data, strs[i]), (SString){.data = (i8 *)buf, .len = len}));
+    }
+
+    // shrinking decommits the tail in place
+    for (u32 i = 0; i < COUNT; i++) StrBaseDel(data, strs[i]);
+    StrBaseShrink(data);
+    assert(data->strstore == store);
+    assert(data->maxslots == first + 1);
+    assert(Sstrcmp(GetStr(data, first), sstring("first")));
+
+    // and recommits on the next growth
+    for (u32 i = 0; i < COUNT; i++) {
+        char buf[16];
+        u32 len = sformat((SString){.data = (i8 *)buf, .len = sizeof(buf)}, "str%d", i);
+        strs[i] = StrBaseAdd(data, (SString){.data = (i8 *)buf, .len = len});
+    }
+    assert(data->strstore == store);
+    assert(data->refs[StrIDSlot(strs[COUNT - 1])] == 1);
+
+    // slot arrays are not on the allocator
+    CountingAllocator c = mem.ctx;
+    assert(c->live < (u64)COUNT * 64);
+
+    StrBaseFree(data);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include "../report.h"
+
+#include <unistd.h>
+
+#define COUNT 1000
+
+static SString name(char *buf, u32 i) {
+    u32 len = sformat((SString){.data = (i8 *)buf, .len = 16}, "str%d", i);
+    return (SString){.data = (i8 *)buf, .len = len};
+}
+
+// every slot of a matches b, ids included
+static void same(StrBase *a, StrBase *b) {
+    assert(a->hashsize == b->hashsize);
+    for (u32 i = 0; i < a->maxslots; i++) {
+        if (!BitmapGet(a->occupied, i))
+            continue;
+
+        StrID id = MakeStrID(i, a->gens[i]);
+        assert(StrBaseValid(b, id));
+        assert(Sstrcmp(StrBaseGet(b, id), GetStr(a, id)));
+        assert(StrBaseFind(b, GetStr(a, id)) == id);
+        assert(b->refs[i] == a->refs[i]);
+    }
+}
+
+int main() {
+    Allocator mem = CountingAllocatorCreate(GlobalAllocator);
+    SString snap = sstring("wal_test.snap");
+    SString log = sstring("wal_test.log");
+    filedelete(snap);
+    filedelete(log);
+    char buf[16];
+
+    StrBase *data = &(StrBase){mem};
+    StrID strs[COUNT] = {0};
+    for (u32 i = 0; i < COUNT; i++) strs[i] = StrBaseAdd(data, name(buf, i));
+    for (u32 i = 0; i < COUNT; i += 3) StrBaseDel(data, strs[i]);
+
+    // snapshot round trip keeps ids and generations
+    assert(StrBaseSave(data, snap));
+    assert(data->epoch == 1);
+
+    StrBase *copy = &(StrBase){mem};
+    assert(StrBaseLoad(copy, snap));
+    assert(copy->epoch == 1);
+    same(data, copy);
+    for (u32 i = 0; i < COUNT; i += 3) assert(!StrBaseValid(copy, strs[i]));
+    StrBaseFree(copy);
+
+    // changes after the snapshot come back from the log
+    assert(StrBaseWalOpen(data, log));
+    for (u32 i = 0; i < COUNT; i += 3) strs[i] = StrBaseAdd(data, name(buf, i));
+    for (u32 i = 1; i < COUNT; i += 3) StrBaseDel(data, strs[i]);
+
+    // refcounts follow every add and release
+    StrID twice = StrBaseAdd(data, name(buf, 5));
+    StrBaseAdd(data, name(buf, 5));
+    StrBaseDel(data, twice);
+    assert(data->refs[StrIDSlot(twice)] == 2);
+    StrBaseWalSync(data);
+
+    copy = &(StrBase){mem};
+    assert(StrBaseLoad(copy, snap));
+    assert(StrBaseWalOpen(copy, log));
+    same(data, copy);
+    for (u32 i = 1; i < COUNT; i += 3) assert(!StrBaseValid(copy, strs[i]));
+
+    // the reopened log keeps appending
+    StrID extra = StrBaseAdd(copy, sstring("extra"));
+    StrBaseFree(copy);
+
+    // a torn tail is dropped, everything before it survives
+    file f = fileopen(log, FILE_WRITE);
+    u64 size = lseek(f.handle, 0, SEEK_END);
+    assert(ftruncate(f.handle, size - 2) == 0);
+    fileclose(f);
+
+    copy = &(StrBase){mem};
+    assert(StrBaseLoad(copy, snap));
+    assert(StrBaseWalOpen(copy, log));
+    same(data, copy);
+    assert(StrBaseFind(copy, sstring("extra")) == STRBASE_INAVLID_STR);
+
+    // new records land right after the last good one
+    extra = StrBaseAdd(copy, sstring("extra"));
+    StrBaseFree(copy);
+
+    copy = &(StrBase){mem};
+    assert(StrBaseLoad(copy, snap));
+    assert(StrBaseWalOpen(copy, log));
+    assert(StrBaseFind(copy, sstring("extra")) == extra);
+    StrBaseDel(copy, extra);
+    StrBaseFree(copy);
+
+    // a checkpoint empties the log, older snapshots refuse it
+    assert(StrBaseCheckpoint(data, snap));
+    assert(data->epoch == 2);
+    StrBaseDel(data, strs[2]);
+    StrBaseWalSync(data);
+
+    copy = &(StrBase){mem};
+    assert(StrBaseLoad(copy, snap));
+    assert(StrBaseWalOpen(copy, log));
+    same(data, copy);
+    StrBaseFree(copy);
+
+    copy = &(StrBase){mem};
+    copy->epoch = 1;
+    assert(!StrBaseWalOpen(copy, log));
+    StrBaseFree(copy);
+
+    // compaction is logged as well
+    StrID *remap = Alloc(mem, data->maxslots * sizeof(StrID));
+    u32 max = data->maxslots;
+    StrBaseCompact(data, remap);
+    Free(mem, remap, max * sizeof(StrID));
+    StrBaseWalClose(data);
+
+    copy = &(StrBase){mem};
+    assert(StrBaseLoad(copy, snap));
+    assert(StrBaseWalOpen(copy, log));
+    same(data, copy);
+    StrBaseFree(copy);
+
+    // and so are the generations of the truncated slots
+    assert(StrBaseSave(data, snap));
+    copy = &(StrBase){mem};
+    assert(StrBaseLoad(copy, snap));
+    assert(copy->maxslots == data->maxslots);
+    for (u32 i = 0; i < data->gencap; i++) assert(copy->gens[i] == data->gens[i]);
+    StrBaseFree(copy);
+
+    // loading needs an empty base and a real snapshot
+    assert(!StrBaseLoad(data, snap));
+    copy = &(StrBase){mem};
+    assert(!StrBaseLoad(copy, log));
+    StrBaseFree(copy);
+
+    StrBaseFree(data);
+    filedelete(snap);
+    filedelete(log);
+
+    report(mem);
+    CountingAllocatorFree(mem);
+    return 0;
+}
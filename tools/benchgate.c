@@ -0,0 +1,237 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#include <dirent.h>
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+    Benchmark regression gate
+
+    usage: benchgate <baseline> [update]
+
+    Runs every binary in build/bench/, collects the
+    "metric <name> <value> <higher|lower>" lines they print and
+    compares them against <baseline>. A metric that got worse by
+    more than STRBASE_BENCH_THRESHOLD percent (default 10) fails
+    the gate, so does a baseline metric no benchmark printed. With "update" the baseline is rewritten instead.
+
+    Each benchmark runs STRBASE_BENCH_RUNS times (default 3) and
+    the best value of every metric is kept to filter out noise.
+*/
+
+#define NAME_SIZE 128
+
+typedef struct Metric {
+    char name[NAME_SIZE];
+    f64 value;
+    bool8 higher; // higher is better
+} Metric;
+
+typedef struct MetricList {
+    Metric *data;
+    u32 size;
+    u32 cap;
+} MetricList;
+
+static void push(MetricList *l, Metric m) {
+    if (l->size == l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 64;
+        l->data = realloc(l->data, l->cap * sizeof(Metric));
+    }
+    l->data[l->size++] = m;
+}
+
+// "<name> <value> <higher|lower>", returns 0 on malformed lines
+static bool8 parse(const char *line, Metric *m) {
+    char dir[16] = {0};
+    if (sscanf(line, "%127s %lf %15s", m->name, &m->value, dir) != 3)
+        return 0;
+    m->higher = strcmp(dir, "higher") == 0;
+    return 1;
+}
+
+static Metric *find(MetricList *l, const char *name) {
+    for (u32 i = 0; i < l->size; i++) {
+        if (strcmp(l->data[i].name, name) == 0)
+            return &l->data[i];
+    }
+    return NULL;
+}
+
+// keeps the better of the two values for metrics seen before
+static void merge(MetricList *l, Metric m) {
+    Metric *old = find(l, m.name);
+    if (!old) {
+        push(l, m);
+        return;
+    }
+
+    if (m.higher ? m.value > old->value : m.value < old->value)
+        old->value = m.value;
+}
+
+static int runbench(const char *path, MetricList *out, bool8 quiet) {
+    FILE *p = popen(path, "r");
+    if (!p) {
+        debugerr("Failed to run %n", path);
+        return -1;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), p)) {
+        Metric m = {0};
+        if (strncmp(line, "metric ", 7) == 0 && parse(line + 7, &m)) {
+            merge(out, m);
+        } else if (!quiet) {
+            fputs(line, stdout);
+        }
+    }
+
+    return pclose(p);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("usage: %s <baseline> [update]\n", argv[0]);
+        return -1;
+    }
+
+    // resolved before setdirExe moves us into build/
+    char baseline[PATH_MAX + 1] = {0};
+    if (argv[1][0] == '/') {
+        strncpy(baseline, argv[1], PATH_MAX);
+    } else {
+        char cwd[PATH_MAX] = {0};
+        getcwd(cwd, sizeof(cwd));
+        snprintf(baseline, PATH_MAX, "%s/%s", cwd, argv[1]);
+    }
+
+    bool8 update = argc > 2 && strcmp(argv[2], "update") == 0;
+
+    f64 threshold = 10.0;
+    char *env = getenv("STRBASE_BENCH_THRESHOLD");
+    if (env)
+        threshold = strtod(env, NULL);
+
+    u32 runs = 3;
+    env = getenv("STRBASE_BENCH_RUNS");
+    if (env && strtoul(env, NULL, 10))
+        runs = strtoul(env, NULL, 10);
+
+    MetricList base = {0};
+    FILE *f = fopen(baseline, "r");
+    if (f) {
+        char line[1024];
+        while (fgets(line, sizeof(line), f)) {
+            Metric m = {0};
+            if (line[0] != '#' && parse(line, &m))
+                push(&base, m);
+        }
+        fclose(f);
+    } else if (!update) {
+        debugwarn("No baseline at %n, every metric is new", baseline);
+    }
+
+    setdirExe();
+
+    MetricList current = {0};
+    int failed = 0;
+
+    DIR *d = opendir("bench/");
+    if (!d) {
+        debugerr("Failed to open bench/");
+        return -1;
+    }
+
+    struct dirent *dir;
+    while ((dir = readdir(d))) {
+        if (dir->d_type == DT_DIR)
+            continue;
+
+        char path[PATH_MAX + 1] = {0};
+        snprintf(path, PATH_MAX, "./bench/%s", dir->d_name);
+        printf("=== %s ===\n", dir->d_name);
+        fflush(stdout);
+
+        for (u32 i = 0; i < runs; i++) {
+            if (runbench(path, &current, i > 0)) {
+                printf("\033[38;2;255;0;0m%s exited with an error\033[0m\n", dir->d_name);
+                failed = 1;
+                break;
+            }
+        }
+    }
+    closedir(d);
+
+    if (update) {
+        FILE *out = fopen(baseline, "w");
+        if (!out) {
+            debugerr("Failed to write %n", baseline);
+            return -1;
+        }
+
+        fprintf(out, "# generated by benchgate update\n");
+        for (u32 i = 0; i < current.size; i++) {
+            Metric *m = &current.data[i];
+            fprintf(out, "%s %.3f %s\n", m->name, m->value, m->higher ? "higher" : "lower");
+        }
+        fclose(out);
+        printf("\nwrote %u metrics to %s\n", current.size, baseline);
+        return failed;
+    }
+
+    printf("\n%-40s %14s %14s %9s\n", "metric", "baseline", "current", "change");
+
+    u32 regressions = 0;
+    for (u32 i = 0; i < current.size; i++) {
+        Metric *m = &current.data[i];
+        Metric *b = find(&base, m->name);
+
+        if (!b) {
+            printf("%-40s %14s %14.3f %9s  new\n", m->name, "-", m->value, "-");
+            continue;
+        }
+
+        // positive change is always worse
+        f64 change = 0;
+        if (b->value != 0) {
+            change = (m->value - b->value) / b->value * 100.0;
+        } else if (m->value != 0) {
+            change = 100.0;
+        }
+        if (m->higher)
+            change = -change;
+
+        const char *status = "";
+        if (change > threshold) {
+            status = "\033[38;2;255;0;0m REGRESSED\033[0m";
+            regressions++;
+        } else if (change < -threshold) {
+            status = "\033[38;2;0;255;0m improved\033[0m";
+        }
+
+        printf("%-40s %14.3f %14.3f %+8.1f%%%s\n", m->name, b->value, m->value, change, status);
+    }
+
+    // a metric that stopped showing up is the worst regression
+    u32 missing = 0;
+    for (u32 i = 0; i < base.size; i++) {
+        Metric *b = &base.data[i];
+        if (find(&current, b->name))
+            continue;
+
+        printf("%-40s %14.3f %14s %9s\033[38;2;255;0;0m missing\033[0m\n", b->name, b->value, "-",
+               "-");
+        missing++;
+    }
+
+    printf("\n%u regression(s) over %.1f%%, %u missing\n", regressions, threshold, missing);
+
+    free(base.data);
+    free(current.data);
+    return (regressions || missing || failed) ? 1 : 0;
+}
@@ -0,0 +1,353 @@
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+    Hash distribution analyzer
+
+    usage: hashstat <corpus> [hashcap]
+
+    Interns every line of <corpus> into a StrBase and reports
+    how the keys land in the robin hood table. The live StrBase
+    (FNVHash32 % hashcap) is measured directly, then every hash
+    in the table below is replayed into a simulated table of the
+    same capacity so the numbers are directly comparable.
+*/
+
+#define PROBE_BUCKETS 8
+#define OCC_BUCKETS 6
+
+typedef u32 (*hash_func)(u8 *data, u32 size);
+
+static u32 fnv32(u8 *data, u32 size) { return FNVHash32(data, size); }
+
+static u32 fnv64fold(u8 *data, u32 size) {
+    u64 h = FNVHash64(data, size);
+    return (u32)(h ^ (h >> 32));
+}
+
+// murmur3 finalizer, fixes the weak low bits of FNV
+static u32 fmix32(u32 h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static u32 fnv32fmix(u8 *data, u32 size) { return fmix32(FNVHash32(data, size)); }
+
+static u32 murmur3(u8 *data, u32 size) {
+    u32 h = 0x9747b28c;
+    u32 nblocks = size / 4;
+
+    for (u32 i = 0; i < nblocks; i++) {
+        u32 k;
+        memcpy(&k, data + i * 4, sizeof(k));
+        k *= 0xcc9e2d51;
+        k = (k << 15) | (k >> 17);
+        k *= 0x1b873593;
+
+        h ^= k;
+        h = (h << 13) | (h >> 19);
+        h = h * 5 + 0xe6546b64;
+    }
+
+    u8 *tail = data + nblocks * 4;
+    u32 k = 0;
+    switch (size & 3) {
+    case 3: k ^= tail[2] << 16;
+    case 2: k ^= tail[1] << 8;
+    case 1:
+        k ^= tail[0];
+        k *= 0xcc9e2d51;
+        k = (k << 15) | (k >> 17);
+        k *= 0x1b873593;
+        h ^= k;
+    }
+
+    h ^= size;
+    return fmix32(h);
+}
+
+static const struct {
+    const char *name;
+    hash_func f;
+} hashes[] = {
+    {"fnv32", fnv32},
+    {"fnv64-fold", fnv64fold},
+    {"fnv32+fmix", fnv32fmix},
+    {"murmur3", murmur3},
+};
+
+typedef struct TableStats {
+    u32 keys;
+    u32 cap;
+
+    u32 homecollisions; // keys whose home bucket was already claimed
+    u32 fullcollisions; // distinct keys with identical 32 bit hashes
+
+    u64 probetotal;
+    u32 probemax;
+    u32 probehist[PROBE_BUCKETS]; // 0,1,2,3,4-7,8-15,16-31,32+
+
+    u32 clusters;
+    u64 clustertotal;
+    u32 clustermax;
+
+    u32 occupancy[OCC_BUCKETS]; // buckets that are home to 0..5+ keys
+} TableStats;
+
+static u32 histbucket(u32 v) {
+    if (v < 4)
+        return v;
+    u32 b = 2; // log2(v) + 2
+    while (v >>= 1) b++;
+    return b < PROBE_BUCKETS ? b : PROBE_BUCKETS - 1;
+}
+
+static int cmpu32(const void *a, const void *b) {
+    u32 x = *(const u32 *)a, y = *(const u32 *)b;
+    return (x > y) - (x < y);
+}
+
+// probe and cluster numbers from a finished meta array
+static void scanmeta(TableStats *st, i32 *meta, u32 cap) {
+    // start right after an empty bucket so wrapping clusters count once
+    u32 origin = 0;
+    while (origin < cap && meta[origin] != STRBASE_INAVLID_STR) origin++;
+
+    u32 run = 0;
+    for (u32 j = 1; j <= cap; j++) {
+        u32 i = (origin + j) % cap;
+        if (meta[i] == STRBASE_INAVLID_STR) {
+            if (run) {
+                st->clusters++;
+                st->clustertotal += run;
+                if (run > st->clustermax)
+                    st->clustermax = run;
+            }
+            run = 0;
+            continue;
+        }
+        run++;
+
+        u32 p = meta[i];
+        st->probetotal += p;
+        if (p > st->probemax)
+            st->probemax = p;
+        st->probehist[histbucket(p)]++;
+    }
+
+    if (run) {
+        // completely full table
+        st->clusters++;
+        st->clustertotal += run;
+        st->clustermax = run;
+    }
+}
+
+// home bucket occupancy and collision counts from raw hashes
+static void scanhomes(TableStats *st, u32 *h, u32 n, u32 cap) {
+    u32 *homes = calloc(cap, sizeof(u32));
+    for (u32 i = 0; i < n; i++) {
+        u32 home = h[i] % cap;
+        if (homes[home])
+            st->homecollisions++;
+        homes[home]++;
+    }
+    for (u32 i = 0; i < cap; i++) {
+        u32 b = homes[i] < OCC_BUCKETS ? homes[i] : OCC_BUCKETS - 1;
+        st->occupancy[b]++;
+    }
+    free(homes);
+
+    u32 *sorted = malloc(n * sizeof(u32));
+    memcpy(sorted, h, n * sizeof(u32));
+    qsort(sorted, n, sizeof(u32), cmpu32);
+    for (u32 i = 1; i < n; i++) {
+        if (sorted[i] == sorted[i - 1])
+            st->fullcollisions++;
+    }
+    free(sorted);
+}
+
+// replays the StrBase robin hood insert on bare hashes
+static TableStats simulate(u32 *h, u32 n, u32 cap) {
+    TableStats st = {.keys = n, .cap = cap};
+
+    i32 *meta = malloc(cap * sizeof(i32));
+    u32 *keys = malloc(cap * sizeof(u32));
+    memset(meta, -1, cap * sizeof(i32));
+
+    for (u32 k = 0; k < n; k++) {
+        u32 key = k;
+        u32 idx = h[key] % cap;
+        u32 counter = 0;
+
+        for (u32 i = 0; i < cap; i++) {
+            if (meta[idx] == STRBASE_INAVLID_STR) {
+                meta[idx] = counter;
+                keys[idx] = key;
+                break;
+            }
+
+            if (meta[idx] < counter) {
+                u32 tmpcounter = meta[idx];
+                u32 tmpkey = keys[idx];
+
+                meta[idx] = counter;
+                keys[idx] = key;
+
+                counter = tmpcounter;
+                key = tmpkey;
+            }
+
+            idx = (idx + 1) % cap;
+            counter++;
+        }
+    }
+
+    scanmeta(&st, meta, cap);
+    scanhomes(&st, h, n, cap);
+
+    free(meta);
+    free(keys);
+    return st;
+}
+
+static void printstats(const char *name, TableStats *st) {
+    f64 n = st->keys ? st->keys : 1;
+    printf("%-12s %8.3f%% %6u %8.3f %6u |", name, 100.0 * st->homecollisions / n,
+           st->fullcollisions, st->probetotal / n, st->probemax);
+    for (u32 i = 0; i < PROBE_BUCKETS; i++) printf(" %6.2f", 100.0 * st->probehist[i] / n);
+    printf(" | %7.2f %6u\n", st->clusters ? (f64)st->clustertotal / st->clusters : 0.0,
+           st->clustermax);
+}
+
+static void printoccupancy(const char *name, TableStats *st) {
+    // Poisson(load) is what a uniform hash would give
+    f64 lambda = (f64)st->keys / st->cap;
+    f64 chi = 0;
+
+    printf("%-12s", name);
+    f64 tail = 1.0;
+    for (u32 k = 0; k < OCC_BUCKETS; k++) {
+        f64 p = exp(-lambda) * pow(lambda, k) / tgamma(k + 1);
+        if (k == OCC_BUCKETS - 1)
+            p = tail;
+        tail -= p;
+
+        f64 expected = p * st->cap;
+        if (expected > 0)
+            chi += (st->occupancy[k] - expected) * (st->occupancy[k] - expected) / expected;
+        printf(" %10u/%-10.0f", st->occupancy[k], expected);
+    }
+    printf(" chi2 %.1f\n", chi);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("usage: %s <corpus> [hashcap]\n", argv[0]);
+        return -1;
+    }
+
+    // mapped for the whole run so the keys can be borrowed
+    LString corpus = filemap((SString){.len = strlen(argv[1]), .data = (i8 *)argv[1]},
+                             FILEMAP_SEQUENTIAL | FILEMAP_WILLNEED);
+    if (!corpus.data)
+        return -1;
+
+    StrBase *base = &(StrBase){GlobalAllocator};
+
+    u32 lines = 0;
+    u64 start = 0;
+    for (u64 i = 0; i <= corpus.len; i++) {
+        if (i < corpus.len && corpus.data[i] != '\n')
+            continue;
+
+        u64 end = i;
+        if (end > start && corpus.data[end - 1] == '\r')
+            end--;
+
+        if (end > start) {
+            StrBaseAddBorrowed(base, (SString){.len = end - start, .data = corpus.data + start});
+            lines++;
+        }
+        start = i + 1;
+    }
+
+    // unique keys in slot order, so every hash sees the same input
+    u32 n = 0;
+    SString *keys = malloc(base->hashsize * sizeof(SString));
+    for (u32 i = 0; i < base->maxslots; i++) {
+        if (BitmapGet(base->occupied, i))
+            keys[n++] = base->strstore[i];
+    }
+
+    // every key needs a bucket, the simulated tables drop the rest
+    u64 arg = base->hashcap;
+    char *end = "";
+    if (argc > 2)
+        arg = strtoull(argv[2], &end, 0);
+    if (!arg || arg < n || arg > UINT32_MAX || *end || (argc > 2 && !argv[2][0])) {
+        printf("usage: %s <corpus> [hashcap]\n", argv[0]);
+        printf("hashcap has to be at least the %u unique keys and fit in a u32\n", n ? n : 1);
+        return -1;
+    }
+    u32 cap = arg;
+
+    printf("corpus: %s\n", argv[1]);
+    printf("lines: %u  unique: %u  hashcap: %u  load: %.3f  (STRBASE_LOAD_MAX %.2f)\n\n", lines,
+           n, cap, (f64)n / cap, STRBASE_LOAD_MAX);
+
+    printf("%-12s %9s %6s %8s %6s | %6s %6s %6s %6s %6s %6s %6s %6s | %7s %6s\n", "hash",
+           "homecoll", "full", "avgprobe", "max", "p0", "p1", "p2", "p3", "p4-7", "p8-15",
+           "p16-31", "p32+", "avgclus", "maxclus");
+
+    TableStats all[ARRAY_SIZE(hashes) + 1] = {0};
+
+    {
+        // the table StrBase actually built
+        TableStats *st = &all[0];
+        st->keys = n;
+        st->cap = base->hashcap;
+
+        u32 *h = malloc(n * sizeof(u32));
+        for (u32 i = 0; i < n; i++) h[i] = FNVHash32((u8 *)keys[i].data, keys[i].len);
+
+        scanmeta(st, base->meta, base->hashcap);
+        scanhomes(st, h, n, base->hashcap);
+        free(h);
+        printstats("strbase", st);
+    }
+
+    u32 *h = malloc(n * sizeof(u32));
+    for (u32 j = 0; j < ARRAY_SIZE(hashes); j++) {
+        for (u32 i = 0; i < n; i++) h[i] = hashes[j].f((u8 *)keys[i].data, keys[i].len);
+        all[j + 1] = simulate(h, n, cap);
+        printstats(hashes[j].name, &all[j + 1]);
+    }
+    free(h);
+
+    printf("\nhome bucket occupancy, actual/expected (uniform hash)\n");
+    printf("%-12s", "keys/bucket");
+    for (u32 k = 0; k < OCC_BUCKETS; k++) printf(" %10u%-11s", k, k == OCC_BUCKETS - 1 ? "+" : "");
+    printf("\n");
+
+    printoccupancy("strbase", &all[0]);
+    for (u32 j = 0; j < ARRAY_SIZE(hashes); j++) printoccupancy(hashes[j].name, &all[j + 1]);
+
+    free(keys);
+    StrBaseFree(base);
+    fileunmap(corpus);
+    return 0;
+}
@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+#define CU_IMPL
+#include <cutils.h>
+
+#define STRBASE_IMPL
+#include <strbase.h>
+
+#include <strclient.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+    StrBase interning daemon
+
+    usage: strbased <socket>
+
+    Owns one StrBase and serves intern/lookup/release/get
+    requests over a Unix socket so every process on the box
+    sees the same StrIDs. Requests are framed and pipelined,
+    see strclient.h for the wire format. Frames of a connection
+    are answered in order, a malformed frame drops the
+    connection. References are global, a client that exits
+    without releasing its strings leaves them interned.
+
+    Stops cleanly on SIGINT or SIGTERM.
+*/
+
+typedef struct Conn {
+    int fd;
+
+    u8 *in;
+    u64 insize;
+    u64 incap;
+
+    u8 *out;
+    u64 outsize;
+    u64 outsent;
+    u64 outcap;
+} Conn;
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int sig) { running = 0; }
+
+static void grow(u8 **buf, u64 *cap, u64 need) {
+    if (need <= *cap)
+        return;
+
+    u64 newcap = *cap ? *cap : PAGE_SIZE;
+    while (newcap < need) newcap *= 2;
+    *buf = realloc(*buf, newcap);
+    *cap = newcap;
+}
+
+static u8 *reply(Conn *c, u64 size) {
+    grow(&c->out, &c->outcap, c->outsize + size);
+    u8 *p = c->out + c->outsize;
+    c->outsize += size;
+    return p;
+}
+
+// fills in the header of the reply frame at, c->out may have moved
+// while replying and frames after a string reply are not aligned
+static void closeframe(Conn *c, u64 at, u32 op, u32 count) {
+    StrWireHeader out = {
+        .op = op,
+        .count = count,
+        .bytes = c->outsize - at - sizeof(StrWireHeader),
+    };
+    memcpy(c->out + at, &out, sizeof(out));
+}
+
+// answers one frame, 0 if it is malformed. GET replies are split
+// into several frames rather than go past STRWIRE_MAX_FRAME, every
+// string came in through a frame so a single one always fits
+static bool8 handle(StrBase *base, Conn *c, StrWireHeader *hdr, u8 *p) {
+    u8 *end = p + hdr->bytes;
+
+    u64 at = c->outsize;
+    u32 count = 0;
+    reply(c, sizeof(StrWireHeader));
+
+    for (u32 i = 0; i < hdr->count; i++) {
+        switch (hdr->op) {
+        case STRWIRE_INTERN:
+        case STRWIRE_LOOKUP: {
+            u32 len;
+            if (end - p < sizeof(u32))
+                return 0;
+            memcpy(&len, p, sizeof(u32));
+            p += sizeof(u32);
+            if (end - p < len)
+                return 0;
+
+            SString s = {.len = len, .data = (i8 *)p};
+            StrID id = hdr->op == STRWIRE_INTERN ? StrBaseAdd(base, s) : StrBaseFind(base, s);
+            memcpy(reply(c, sizeof(StrID)), &id, sizeof(StrID));
+            p += len;
+        } break;
+
+        case STRWIRE_RELEASE:
+        case STRWIRE_GET: {
+            StrID id;
+            if (end - p < sizeof(StrID))
+                return 0;
+            memcpy(&id, p, sizeof(StrID));
+            p += sizeof(StrID);
+
+            if (hdr->op == STRWIRE_RELEASE) {
+                StrBaseDel(base, id);
+                break;
+            }
+
+            SString s = StrBaseGet(base, id);
+            u64 bytes = c->outsize - at - sizeof(StrWireHeader);
+            if (count && bytes + sizeof(u32) + s.len > STRWIRE_MAX_FRAME) {
+                closeframe(c, at, hdr->op, count);
+                at = c->outsize;
+                count = 0;
+                reply(c, sizeof(StrWireHeader));
+            }
+
+            u8 *r = reply(c, sizeof(u32) + s.len);
+            memcpy(r, &s.len, sizeof(u32));
+            memcpy(r + sizeof(u32), s.data, s.len);
+        } break;
+
+        default: return 0;
+        }
+        count++;
+    }
+
+    closeframe(c, at, hdr->op, count);
+    return p == end;
+}
+
+// reads what is available and answers every complete frame
+static bool8 readconn(StrBase *base, Conn *c) {
+    while (1) {
+        grow(&c->in, &c->incap, c->insize + PAGE_SIZE);
+        i64 got = read(c->fd, c->in + c->insize, c->incap - c->insize);
+        if (got > 0) {
+            c->insize += got;
+            continue;
+        }
+        if (got == 0)
+            return 0;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+        if (errno != EINTR)
+            return 0;
+    }
+
+    u64 off = 0;
+    while (c->insize - off >= sizeof(StrWireHeader)) {
+        StrWireHeader hdr;
+        memcpy(&hdr, c->in + off, sizeof(hdr));
+        if (hdr.bytes > STRWIRE_MAX_FRAME)
+            return 0;
+        if (c->insize - off - sizeof(hdr) < hdr.bytes)
+            break;
+
+        if (!handle(base, c, &hdr, c->in + off + sizeof(hdr)))
+            return 0;
+        off += sizeof(hdr) + hdr.bytes;
+    }
+
+    memmove(c->in, c->in + off, c->insize - off);
+    c->insize -= off;
+    return 1;
+}
+
+static bool8 writeconn(Conn *c) {
+    while (c->outsent < c->outsize) {
+        i64 sent = write(c->fd, c->out + c->outsent, c->outsize - c->outsent);
+        if (sent > 0) {
+            c->outsent += sent;
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 1;
+        if (sent < 0 && errno == EINTR)
+            continue;
+        return 0;
+    }
+
+    c->outsize = c->outsent = 0;
+    return 1;
+}
+
+static void closeconn(Conn *c) {
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("usage: %s <socket>\n", argv[0]);
+        return -1;
+    }
+
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(argv[1]) >= sizeof(addr.sun_path)) {
+        debugerr("Socket path too long: %n", argv[1]);
+        return -1;
+    }
+    strcpy(addr.sun_path, argv[1]);
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(argv[1]);
+    if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) || listen(lfd, 128)) {
+        debugerr("Failed to listen on %n", argv[1]);
+        return -1;
+    }
+
+    struct sigaction sa = {.sa_handler = stop};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    StrBase *base = &(StrBase){GlobalAllocator};
+
+    Conn *conns = NULL;
+    struct pollfd *fds = NULL;
+    u32 nconns = 0;
+    u32 cap = 0;
+
+    while (running) {
+        if (nconns + 1 > cap) {
+            cap = cap ? cap * 2 : 16;
+            conns = realloc(conns, cap * sizeof(Conn));
+            fds = realloc(fds, (cap + 1) * sizeof(struct pollfd));
+        }
+
+        fds[0] = (struct pollfd){.fd = lfd, .events = POLLIN};
+        for (u32 i = 0; i < nconns; i++) {
+            fds[i + 1] = (struct pollfd){.fd = conns[i].fd, .events = POLLIN};
+            if (conns[i].outsize > conns[i].outsent)
+                fds[i + 1].events |= POLLOUT;
+        }
+
+        if (poll(fds, nconns + 1, -1) < 0)
+            continue; // EINTR, running is checked again
+
+        // walk backwards so closed connections can be swapped out
+        for (u32 i = nconns; i > 0; i--) {
+            Conn *c = &conns[i - 1];
+            short ev = fds[i].revents;
+            if (!ev)
+                continue;
+
+            bool8 ok = !(ev & (POLLERR | POLLNVAL));
+            if (ok && (ev & (POLLIN | POLLHUP)))
+                ok = readconn(base, c);
+            if (ok)
+                ok = writeconn(c);
+
+            if (!ok) {
+                closeconn(c);
+                *c = conns[--nconns];
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            int flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+            while (nconns < cap && (fd = accept4(lfd, NULL, NULL, flags)) >= 0) {
+                conns[nconns++] = (Conn){.fd = fd};
+            }
+        }
+    }
+
+    for (u32 i = 0; i < nconns; i++) closeconn(&conns[i]);
+    free(conns);
+    free(fds);
+
+    close(lfd);
+    unlink(argv[1]);
+    StrBaseFree(base);
+    return 0;
+}